@@ -0,0 +1,90 @@
+#include "asar/AsarIndex.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Synthetic header text of roughly the requested size in MiB.
+static std::string makeHeaderString(int megabytes) {
+  Json::Value header;
+  Json::Value& root = header["files"]["node_modules"]["files"];
+  uint64_t offset = 0;
+  size_t approx = 0;
+  for (int p = 0; approx < static_cast<size_t>(megabytes) * 1024 * 1024; p++) {
+    Json::Value& pkgFiles = root["package-" + std::to_string(p)]["files"];
+    for (int d = 0; d < 4; d++) {
+      Json::Value& dirFiles = pkgFiles["lib" + std::to_string(d)]["files"];
+      for (int f = 0; f < 40; f++) {
+        Json::Value& file = dirFiles["module-" + std::to_string(f) + ".js"];
+        file["size"] = 1024;
+        file["offset"] = std::to_string(offset);
+        if (f % 10 == 0) file["executable"] = true;
+        if (f % 20 == 0) {
+          file["integrity"]["algorithm"] = "SHA256";
+          file["integrity"]["hash"] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+        }
+        offset += 1024;
+        approx += 64;
+      }
+    }
+  }
+  Json::StreamWriterBuilder wb;
+  wb.settings_["indentation"] = "";
+  return Json::writeString(wb, header);
+}
+
+int main(int argc, char** argv) {
+  int megabytes = argc > 1 ? atoi(argv[1]) : 40;
+  std::string text = makeHeaderString(megabytes);
+  printf("header: %.1f MiB\n", text.size() / 1048576.0);
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::istringstream is(text);
+  Json::Value dom;
+  is >> dom;
+  asar::AsarIndex fromDom(dom);
+  auto t1 = std::chrono::steady_clock::now();
+  asar::AsarIndex parsed = asar::AsarIndex::parse(text.data(), text.size());
+  auto t2 = std::chrono::steady_clock::now();
+
+  double domMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  double parseMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+  printf("jsoncpp DOM + index:  %8.1f ms (%zu entries)\n", domMs, fromDom.size());
+  printf("AsarIndex::parse:     %8.1f ms (%zu entries)\n", parseMs, parsed.size());
+  printf("speedup: %.2fx\n", domMs / parseMs);
+
+  std::vector<char> buffer(text.begin(), text.end());
+  auto t3 = std::chrono::steady_clock::now();
+  asar::AsarIndex lazy = asar::AsarIndex::parseLazy(std::move(buffer), 0, text.size());
+  auto t4 = std::chrono::steady_clock::now();
+  size_t found = 0;
+  for (int p = 0; p < 100; p++) {
+    if (lazy.find("/node_modules/package-" + std::to_string(p) + "/lib1/module-7.js") != asar::AsarIndex::npos) found++;
+  }
+  auto t5 = std::chrono::steady_clock::now();
+  double lazyMs = std::chrono::duration<double, std::milli>(t4 - t3).count();
+  double touchMs = std::chrono::duration<double, std::milli>(t5 - t4).count();
+  printf("AsarIndex::parseLazy: %8.1f ms open, %.1f ms for %zu lookups (%zu entries loaded)\n", lazyMs, touchMs, found, lazy.size());
+
+  // A persisted index only has to be mapped and validated.
+  asar::AsarIndex::CacheKey key = { text.size(), 0, 0 };
+  std::string cachePath = "asarbench_header.idx";
+  parsed.save(cachePath, key);
+  auto t6 = std::chrono::steady_clock::now();
+  asar::AsarIndex cached;
+  bool hit = asar::AsarIndex::load(cachePath, key, 0, UINT64_MAX, &cached);
+  auto t7 = std::chrono::steady_clock::now();
+  double cachedMs = std::chrono::duration<double, std::milli>(t7 - t6).count();
+  printf("AsarIndex::load:      %8.1f ms (%s, %zu entries)\n", cachedMs, hit ? "hit" : "miss", cached.size());
+
+  bool same = hit && parsed.toJson() == cached.toJson();
+  remove(cachePath.c_str());
+  if (fromDom.toJson() != parsed.toJson() || parsed.toJson() != lazy.toJson() || !same) {
+    printf("MISMATCH between DOM, streaming, lazy and cached index\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+#include "asar/AsarIndex.hpp"
+#include "asar/AsarFileSystem.hpp"
+#include "toyo/path.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Synthetic node_modules-shaped header: packages / dirs / files.
+static Json::Value makeHeader(int packages, int dirs, int files, std::vector<std::string>* paths) {
+  Json::Value header;
+  Json::Value& root = header["files"]["node_modules"]["files"];
+  uint64_t offset = 0;
+  for (int p = 0; p < packages; p++) {
+    std::string pkg = "package-" + std::to_string(p);
+    Json::Value& pkgFiles = root[pkg]["files"];
+    pkgFiles["package.json"]["size"] = 512;
+    pkgFiles["package.json"]["offset"] = std::to_string(offset);
+    offset += 512;
+    for (int d = 0; d < dirs; d++) {
+      std::string dir = "lib" + std::to_string(d);
+      Json::Value& dirFiles = pkgFiles[dir]["files"];
+      for (int f = 0; f < files; f++) {
+        std::string file = "module-" + std::to_string(f) + ".js";
+        dirFiles[file]["size"] = 1024;
+        dirFiles[file]["offset"] = std::to_string(offset);
+        offset += 1024;
+        paths->push_back("/node_modules/" + pkg + "/" + dir + "/" + file);
+      }
+    }
+  }
+  return header;
+}
+
+// Lookup as it was before PathSegments: normalize with toyo::path::join,
+// split on the separator with strtok_r into strings, then walk the DOM.
+static std::vector<std::string> legacySplit(const std::string& self, const std::string& separator) {
+  std::vector<char> copy(self.begin(), self.end());
+  copy.push_back('\0');
+  std::vector<std::string> res;
+#ifdef _MSC_VER
+  char* token = strtok(copy.data(), separator.c_str());
+  while (token != NULL) {
+    res.push_back(token);
+    token = strtok(NULL, separator.c_str());
+  }
+#else
+  char* buffer;
+  char* token = strtok_r(copy.data(), separator.c_str(), &buffer);
+  while (token != NULL) {
+    res.push_back(token);
+    token = strtok_r(NULL, separator.c_str(), &buffer);
+  }
+#endif
+  return res;
+}
+
+// Returns a copy, as AsarFileSystem::getNode still does, so only the path handling differs.
+static Json::Value legacyGetNode(const Json::Value& header, const std::string& path) {
+  std::string p = toyo::path::join(path);
+  if (p[0] == '/' || p[0] == '\\') p = p.substr(1);
+  if (p == "" || p == ".") return header;
+  std::vector<std::string> paths = legacySplit(p, toyo::path::sep);
+  const Json::Value* pointer = &header["files"];
+  for (size_t i = 0; i + 1 < paths.size(); i++) {
+    if (!pointer->isMember(paths[i]) || !(*pointer)[paths[i]].isMember("files")) return Json::Value(Json::nullValue);
+    pointer = &(*pointer)[paths[i]]["files"];
+  }
+  return pointer->isMember(paths.back()) ? (*pointer)[paths.back()] : Json::Value(Json::nullValue);
+}
+
+template <typename Callable>
+static double measure(const char* label, const std::vector<std::string>& queries, const Callable& lookup) {
+  size_t found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const std::string& q : queries) {
+    if (lookup(q)) found++;
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+  printf("%-32s %10.1f ns/lookup  (%zu/%zu found)\n", label, ns, found, queries.size());
+  return ns;
+}
+
+int main(int argc, char** argv) {
+  int packages = argc > 1 ? atoi(argv[1]) : 1000;
+  int lookups = argc > 2 ? atoi(argv[2]) : 200000;
+
+  std::vector<std::string> paths;
+  Json::Value header = makeHeader(packages, 4, 40, &paths);
+
+  asar::AsarFileSystem dom(header);
+  asar::AsarIndex walk(header);
+  asar::AsarIndex hashed(header);
+  hashed.buildHashTable();
+  printf("entries: %zu\n", walk.size());
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<size_t> pick(0, paths.size() - 1);
+  std::vector<std::string> queries;
+  queries.reserve(lookups);
+  for (int i = 0; i < lookups; i++) {
+    queries.push_back(pick(rng) % 8 == 0 ? paths[pick(rng)] + ".missing" : paths[pick(rng)]);
+  }
+
+  // Lookups used to normalize every path with toyo::path::join first.
+  measure("toyo::path::join only", queries, [&](const std::string& q) { return toyo::path::join(q).size() > 1; });
+  double before = measure("Json::Value join+split", queries, [&](const std::string& q) { return !legacyGetNode(header, q).isNull(); });
+  double after = measure("Json::Value tokenizer", queries, [&](const std::string& q) { return !dom.getNode(q).isNull(); });
+  printf("tokenizer speedup over join+split: %.2fx\n", before / after);
+  double w = measure("AsarIndex walk", queries, [&](const std::string& q) { return walk.find(q) != asar::AsarIndex::npos; });
+  double h = measure("AsarIndex hash", queries, [&](const std::string& q) { return hashed.find(q) != asar::AsarIndex::npos; });
+  printf("hash speedup over walk: %.2fx\n", w / h);
+
+  // Unnormalized spellings of the same paths are resolved by the tokenizer in the same pass.
+  std::vector<std::string> messy;
+  messy.reserve(queries.size());
+  for (const std::string& q : queries) {
+    std::string m = "." + q;
+    size_t pos = m.find('/', 2);
+    if (pos != std::string::npos) m.insert(pos, "//lib0/..\\.");
+    messy.push_back(m);
+  }
+  measure("Json::Value tokenizer (messy)", messy, [&](const std::string& q) { return !dom.getNode(q).isNull(); });
+  measure("AsarIndex walk (messy)", messy, [&](const std::string& q) { return walk.find(q) != asar::AsarIndex::npos; });
+  measure("AsarIndex hash (messy)", messy, [&](const std::string& q) { return hashed.find(q) != asar::AsarIndex::npos; });
+  return 0;
+}
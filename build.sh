@@ -1,6 +1,7 @@
 type="Release"
 dll="false"
 test="false"
+bench="false"
 
 until [ $# -eq 0 ]
 do
@@ -8,6 +9,7 @@ if [ "$1" == "Release" ]; then type="$1"; fi
 if [ "$1" == "Debug" ]; then type="$1"; fi
 if [ "$1" == "dll" ]; then dll="true"; fi
 if [ "$1" == "test" ]; then test="true"; fi
+if [ "$1" == "bench" ]; then bench="true"; fi
 shift
 done
 
@@ -16,8 +18,8 @@ os=`echo $unamestr | tr "A-Z" "a-z"`
 
 mkdir -p "./build/$os/$type"
 cd "./build/$os/$type"
-echo "cmake -DCCPM_BUILD_DLL=$dll -DCCPM_BUILD_TEST=$test -DCMAKE_BUILD_TYPE=$type ../../.."
-cmake -DCCPM_BUILD_DLL="$dll" -DCCPM_BUILD_TEST="$test" -DCMAKE_BUILD_TYPE=$type ../../..
+echo "cmake -DCCPM_BUILD_DLL=$dll -DCCPM_BUILD_TEST=$test -DCCPM_BUILD_BENCH=$bench -DCMAKE_BUILD_TYPE=$type ../../.."
+cmake -DCCPM_BUILD_DLL="$dll" -DCCPM_BUILD_TEST="$test" -DCCPM_BUILD_BENCH="$bench" -DCMAKE_BUILD_TYPE=$type ../../..
 cmake --build .
 cd ../../..
 
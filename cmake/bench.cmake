@@ -0,0 +1,21 @@
+file(GLOB BENCH_SOURCE_FILES "bench/*.cpp")
+
+foreach(BENCH_SOURCE ${BENCH_SOURCE_FILES})
+  get_filename_component(BENCH_NAME ${BENCH_SOURCE} NAME_WE)
+  set(BENCH_EXE_NAME "asarbench_${BENCH_NAME}")
+
+  add_executable(${BENCH_EXE_NAME} ${BENCH_SOURCE})
+
+  set_target_properties(${BENCH_EXE_NAME} PROPERTIES CXX_STANDARD 11)
+
+  target_link_libraries(${BENCH_EXE_NAME} ${LIB_NAME})
+
+  if(WIN32 AND MSVC)
+    target_compile_options(${BENCH_EXE_NAME} PRIVATE /utf-8)
+    target_compile_definitions(${BENCH_EXE_NAME} PRIVATE
+      _CRT_SECURE_NO_WARNINGS
+      UNICODE
+      _UNICODE
+    )
+  endif()
+endforeach()
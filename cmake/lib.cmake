@@ -31,7 +31,8 @@ set(BUILD_STATIC_LIBS ON)
 set(JSONCPP_WITH_TESTS OFF)
 add_subdirectory(deps/jsoncpp)
 
-target_link_libraries(${LIB_NAME} jsoncpp_lib)
+find_package(Threads REQUIRED)
+target_link_libraries(${LIB_NAME} jsoncpp_lib Threads::Threads)
 
 # target_include_directories(${TEST_EXE_NAME} PRIVATE "deps/jsoncpp/include")
 
@@ -1,18 +1,32 @@
 file(GLOB_RECURSE TEST_SOURCE_FILES "test/*.c" "test/*.cpp")
 
+# GlobSet is internal to the library, so its test compiles it in directly.
 add_executable(${TEST_EXE_NAME}
   ${TEST_SOURCE_FILES}
+  "${CMAKE_CURRENT_SOURCE_DIR}/src/lib/GlobSet.cpp"
 )
 
+target_include_directories(${TEST_EXE_NAME} PRIVATE "${CMAKE_CURRENT_SOURCE_DIR}/src/lib")
+
 set_target_properties(${TEST_EXE_NAME} PROPERTIES CXX_STANDARD 11)
 
 target_link_libraries(${TEST_EXE_NAME} ${LIB_NAME})
 
 target_compile_definitions(${TEST_EXE_NAME} PRIVATE
   ASAR_INPUT_1="${CMAKE_CURRENT_SOURCE_DIR}/test/input/packthis"
+  ASAR_INPUT_2="${CMAKE_CURRENT_SOURCE_DIR}/test/output/scanthis"
   ASAR_OUTPUT_1="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis.asar"
   ASAR_OUTPUT_2="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis-unpack.asar"
   ASAR_OUTPUT_3="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis-transformed.asar"
+  ASAR_OUTPUT_4="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis-sequential.asar"
+  ASAR_OUTPUT_5="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis-filtered.asar"
+  ASAR_OUTPUT_6="${CMAKE_CURRENT_SOURCE_DIR}/test/output/scanthis.asar"
+  ASAR_OUTPUT_7="${CMAKE_CURRENT_SOURCE_DIR}/test/output/scanthis-sequential.asar"
+  ASAR_OUTPUT_8="${CMAKE_CURRENT_SOURCE_DIR}/test/output/crafted.asar"
+  ASAR_OUTPUT_9="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis-link.asar"
+  ASAR_OUTPUT_10="${CMAKE_CURRENT_SOURCE_DIR}/test/output/lazy.asar"
+  ASAR_ORDERING_1="${CMAKE_CURRENT_SOURCE_DIR}/test/output/packthis.order"
+  ASAR_INDEX_CACHE_1="${CMAKE_CURRENT_SOURCE_DIR}/test/output/indexcache"
   ASAR_EXTRACT_1="${CMAKE_CURRENT_SOURCE_DIR}/test/output/unpack"
 )
 
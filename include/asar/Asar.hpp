@@ -4,14 +4,17 @@
 
 #include "asar.h"
 #include "AsarFileSystem.hpp"
+#include "AsarIndex.hpp"
+#include "AsarView.hpp"
+#include "AsarStream.hpp"
+#include "AsarAsync.hpp"
 #include <cstddef>
 #include <cstdio>
+#include <exception>
+#include <functional>
+#include <future>
 
 namespace toyo {
-  namespace fs {
-    std::vector<std::string> readdir(const std::string&);
-  }
-
   namespace path {
     template <typename... Args>
     std::string join(Args... args);
@@ -22,16 +25,32 @@ namespace toyo {
 
 namespace asar {
 
+class RandomAccessFile;
+class ReadQueue;
+class ThreadPool;
+class ContentCache;
+class GlobSet;
+struct ScannedEntry;
+
 class Asar {
  private:
-  FILE* _fd;
+  std::shared_ptr<RandomAccessFile> _file;
   std::string _src;
   uint32_t _headerSize;
   uint64_t _fileSize;
-  AsarFileSystem _fs;
+  AsarIndex _index;
   std::string _tmp;
+  asar_open_options_t _options;
+  std::string _indexCache;
+  std::shared_ptr<MappedFile> _mapping;
+  std::shared_ptr<ReadQueue> _queue;
+  struct IOPool;
+  std::shared_ptr<IOPool> _ioPool;
+  std::shared_ptr<ContentCache> _cache;
+  struct AccessLog;
+  std::shared_ptr<AccessLog> _accessLog;
 
-  void _init(const std::string& src = "", uint32_t headerSize = 0, uint64_t fileSize = 0, AsarFileSystem* fs = nullptr, const std::string& tmp = "");
+  void _init(const std::string& src = "", uint32_t headerSize = 0, uint64_t fileSize = 0, AsarIndex* index = nullptr, const std::string& tmp = "");
  public:
   ~Asar();
   Asar();
@@ -40,31 +59,70 @@ class Asar {
   Asar& operator=(const Asar&) = delete;
   Asar& operator=(Asar&&) = default;
   void open(const std::string& asarPath);
+  void open(const std::string& asarPath, const asar_open_options_t& options);
   void close();
   bool isOpen() const;
   const std::string& getTempDir() const;
   std::string getTempPath(const std::string&) const;
   const std::string& getSrc() const;
   Json::Value getNode(const std::string&) const;
+  AsarNode stat(const std::string&) const;
   uint64_t getFileSize() const;
   uint32_t getHeaderSize() const;
   std::string getHeaderJsonString(bool format = false) const;
   bool exists(const std::string&) const;
   std::vector<std::string> readdir(const std::string& path) const;
   std::vector<uint8_t> readFile(const std::string& path) const;
+  // Reads at most length bytes starting at offset; shorter near the end of the file.
+  std::vector<uint8_t> readFile(const std::string& path, uint64_t offset, size_t length) const;
+  size_t readFile(const std::string& path, uint64_t offset, void* out, size_t length) const;
+  // Resolves the path once and copies up to length bytes straight into out (which may be null).
+  // Returns the full size of the file, so a short buffer can be detected without another lookup.
+  uint64_t readFileInto(const std::string& path, void* out, size_t length) const;
+  // Points straight into the archive when it was opened with the mmap option.
+  // Otherwise the buffer is shared with the content cache, if there is one.
+  AsarView readFileView(const std::string& path) const;
+  // Maps only the bytes of this file. Files packed with alignment start on a
+  // page boundary, so the view can go to APIs that need page-aligned memory.
+  AsarView mapFile(const std::string& path) const;
+  asar_cache_stats_t cacheStats() const;
+  // Asks the kernel to start reading the files, or everything under the
+  // directories, into the page cache. Missing paths are skipped.
+  void prefetch(const std::vector<std::string>& paths) const;
+  // Files read so far, in order of first read, when opened with record_access.
+  std::vector<std::string> accessOrder() const;
+  // Writes accessOrder() one path per line, in the format pack reads as an ordering.
+  void writeAccessOrder(const std::string& path) const;
+  // Opens a file for chunked reading instead of loading it whole.
+  AsarStream openStream(const std::string& path) const;
+  // Reads many files with as few large sequential reads as possible.
+  std::vector<std::vector<uint8_t>> readFiles(const std::vector<std::string>& paths) const;
+  // Same as above into caller buffers: up to lengths[i] bytes of paths[i] go to outs[i],
+  // and sizes[i] receives the full size of the file. A null outs only fills sizes.
+  void readFiles(const std::vector<std::string>& paths, uint8_t* const* outs, const size_t* lengths, uint64_t* sizes) const;
+  // Reads the file on the I/O thread pool of this Asar (sized by io_threads,
+  // started on first use). Failures are rethrown by future::get().
+  std::future<std::vector<uint8_t>> readFileAsync(const std::string& path) const;
+  // Same, calling done on an I/O thread with either an error or the data.
+  typedef std::function<void(std::exception_ptr error, std::vector<uint8_t>& data)> ReadCallback;
+  void readFileAsync(const std::string& path, const ReadCallback& done) const;
+  // Asynchronous reads, for archives opened with async_io. Submitted reads
+  // start at once; reapReads waits for at least minCompletions of them.
+  void submitReads(const std::vector<AsarReadRequest>& requests) const;
+  size_t reapReads(std::vector<AsarReadCompletion>* out, size_t minCompletions = 1) const;
+  size_t pendingReads() const;
+  // "io_uring" or "thread pool", or an empty string without async_io.
+  const char* asyncBackend() const;
   std::vector<std::string> list() const;
   void extract(const std::string&, const std::string&) const;
   void extractTemp(const std::string&) const;
  private:
   
   template <typename Callable>
-  void walk(const Json::Value& node, const Callable& callback, const std::string& path = "") const {
+  void walk(AsarNode node, const Callable& callback, const std::string& path = "") const {
     if (callback(node, path)) {
-      if (node.isMember("files")) {
-        std::vector<std::string> keys = node["files"].getMemberNames();
-        for (const std::string& name : keys) {
-          this->walk(node["files"][name], callback, toyo::path::join(path, name));
-        }
+      for (AsarNode child : node.children()) {
+        this->walk(child, callback, toyo::path::join(path, std::string(child.name(), child.nameLength())));
       }
     }
   }
@@ -73,40 +131,65 @@ class Asar {
 
   struct FileInfo {
     std::string path;
+    // Relative to the archive root, with forward slashes and a leading slash.
+    std::string pathInAsar;
     uint64_t size;
+    uint64_t offset;
     bool unpacked;
     bool symlink;
+    bool alignMatch;
+    // Set when the buffer transform replaced the contents, which are then
+    // in data or the spill file, or empty, and never read from path.
+    bool replaced;
+    // Contents from the buffer transform, written instead of the file at path.
+    std::shared_ptr<const char> data;
+    // Or, once the transformed contents outgrow memory, where they start in HeaderInfo::spill.
+    bool spilled;
+    uint64_t spillOffset;
   };
   class HeaderInfo {
    public:
     AsarFileSystem fs;
     std::vector<FileInfo> files;
     uint64_t size;
+    // Boundary the data region has to start on, 0 when nothing is aligned.
+    uint32_t align;
+    // Temporary file of transformed contents kept out of memory, empty if none.
+    std::string spill;
   };
 
-  template <typename Callable>
-  static void walkDir(const std::string& dir, const Callable& callback) {
-    const auto& items = toyo::fs::readdir(dir);
-    for (size_t i = 0; i < items.size(); i++) {
-      if (items[i] != "." && items[i] != "..") {
-        std::string full = toyo::path::join(dir, items[i]);
-        callback(full);
-      }
-    }
-  }
-
   static void copyDirectory(const std::string src, const std::string& dest, asar_transform_callback_t transform = nullptr);
   static void copyFile(const std::string src, const std::string& dest, asar_transform_callback_t transform = nullptr);
 
-  static HeaderInfo createHeaderInfo(
-    const std::string& dir,
-    const char* unpack = nullptr,
-    uint64_t* offset = nullptr,
-    uint64_t* totalSize = nullptr,
-    std::vector<FileInfo>* files = nullptr,
-    const std::string& rootDir = "");
-  
+  // Scans dir on threads threads (0: one per core), then lays out its files in scan order.
+  // globs decides which entries are unpacked or aligned; entries matching exclude are not scanned.
+  static HeaderInfo createHeaderInfo(const std::string& dir, const GlobSet* globs = nullptr, const GlobSet* exclude = nullptr, uint32_t threads = 0);
+  // Adds the children of dir under nodes (the "files" object of its header node),
+  // appending files to info->files and giving packed ones the next offsets.
+  // Everything is unpacked under a directory matched by an unpack_dirs glob.
+  static void addDirectory(
+    ScannedEntry* dir,
+    const std::string& dirInAsar,
+    const std::string& realRoot,
+    const GlobSet* globs,
+    bool unpackAll,
+    Json::Value* nodes,
+    uint64_t* offset,
+    HeaderInfo* info);
+
+  static void transformFiles(HeaderInfo* info, const asar_pack_options_t& options);
+  // Reorders and realigns the data of packed files as the options ask.
+  static void layout(HeaderInfo* info, const asar_pack_options_t& options);
+
   void _readInfo();
+  void _recordAccess(AsarNode node) const;
+  AsarNode _fileNode(const std::string& path) const;
+  ReadQueue& _readQueue() const;
+  AsarView _view(AsarNode node, const std::string& path) const;
+  std::function<std::vector<uint8_t>()> _reader(const std::string& path) const;
+  void _readPacked(AsarNode node, uint8_t* out, size_t length) const;
+  void _readPackedBatch(const std::vector<AsarNode>& nodes, uint8_t* const* outs, const size_t* lengths) const;
+  void _release();
  public:
   static void pack(
     const std::string& src,
@@ -114,6 +197,7 @@ class Asar {
     const char* unpack = nullptr,
     asar_transform_callback_t transform = nullptr
   );
+  static void pack(const std::string& src, const std::string& dest, const asar_pack_options_t& options);
 };
 
 }
@@ -0,0 +1,33 @@
+#ifndef __ASAR_ASYNC_HPP__
+#define __ASAR_ASYNC_HPP__
+
+#include <cstdint>
+#include <string>
+
+#include "asar.h"
+#include "AsarView.hpp"
+
+namespace asar {
+
+// One read for Asar::submitReads: length bytes of path starting at offset,
+// clamped to the end of the file. userData comes back in the completion.
+struct AsarReadRequest {
+  std::string path;
+  uint64_t userData;
+  uint64_t offset;
+  uint64_t length;
+
+  AsarReadRequest(const std::string& p = "", uint64_t data = 0, uint64_t off = 0, uint64_t len = UINT64_MAX):
+    path(p), userData(data), offset(off), length(len) {}
+};
+
+struct AsarReadCompletion {
+  uint64_t userData;
+  asar_status status;   // ok, not_exists, not_file or file_error
+  int systemError;      // errno of a failed read, 0 otherwise
+  AsarView data;
+};
+
+}
+
+#endif
@@ -37,6 +37,8 @@ class AsarFileSystem {
   void insertNode(const std::string& path, const AsarFileSystemNode& node);
   void removeNode(const std::string& path);
   Json::Value getNode(const std::string& path) const;
+  // Node to edit in place, or nullptr.
+  Json::Value* findNode(const std::string& path);
 
   std::string toJson(bool format = false) const;
 
@@ -45,8 +47,6 @@ class AsarFileSystem {
   const Json::Value& get() const;
  private:
   Json::Value header;
-
-  static std::vector<std::string> split(const std::string& self, const std::string& separator, int limit = -1);
 };
 
 }
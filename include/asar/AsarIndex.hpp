@@ -0,0 +1,232 @@
+#ifndef __ASAR_INDEX_HPP__
+#define __ASAR_INDEX_HPP__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "json/json.h"
+
+namespace asar {
+
+class PathSegments;
+class MappedFile;
+
+// Read-only, flat representation of an asar header.
+// Nodes live in a single array in breadth-first order, so the children of a
+// directory are always a contiguous range. Names, link targets and any header
+// members not modelled here (e.g. "integrity") are kept in one string pool.
+class AsarIndex {
+ public:
+  static const uint32_t npos = 0xFFFFFFFF;
+
+  enum Flags : uint32_t {
+    FLAG_DIRECTORY = 1 << 0,
+    FLAG_UNPACKED = 1 << 1,
+    FLAG_EXECUTABLE = 1 << 2,
+    FLAG_LINK = 1 << 3,
+    FLAG_HAS_SIZE = 1 << 4,
+    FLAG_HAS_OFFSET = 1 << 5,
+    FLAG_UNLOADED = 1 << 6
+  };
+
+  struct Entry {
+    uint32_t name;        // pool offset of the node name
+    uint32_t nameLength;
+    uint32_t parent;
+    uint32_t flags;
+    uint32_t first;       // directory: first child, link: pool offset of target
+    uint32_t count;       // directory: child count, link: target length
+    uint32_t extra;       // pool offset of a JSON object with unmodelled members
+    uint32_t extraLength;
+    uint64_t size;        // unloaded directory: end of its "files" object in the header
+    uint64_t offset;      // absolute position of the data in the archive,
+                          // unloaded directory: start of its "files" object
+  };
+
+  AsarIndex();
+  explicit AsarIndex(const Json::Value& header);
+
+  // Builds the index straight from header JSON text, without a DOM.
+  // dataOffset is added to every header offset so entries hold absolute
+  // archive positions, and packed entries must end within fileSize.
+  static AsarIndex parse(const char* json, size_t length, uint64_t dataOffset = 0, uint64_t fileSize = UINT64_MAX);
+  // Takes ownership of the header and only records where each directory's
+  // "files" object lies; a directory is parsed the first time it is entered.
+  static AsarIndex parseLazy(std::vector<char>&& buffer, size_t begin, size_t length, uint64_t dataOffset = 0, uint64_t fileSize = UINT64_MAX);
+  bool isLazy() const;
+  uint64_t dataOffset() const;
+
+  size_t size() const;
+  const Entry& at(uint32_t id) const;
+  const char* name(uint32_t id) const;
+  const char* link(uint32_t id) const;
+
+  uint32_t find(const std::string& path) const;
+  uint32_t find(const char* path, size_t length) const;
+  uint32_t findChild(uint32_t dir, const char* name, size_t length) const;
+
+  bool exists(const std::string& path) const;
+  std::vector<std::string> readdir(const std::string& path) const;
+
+  Json::Value toJsonValue(uint32_t id = 0) const;
+  std::string toJson(bool format = false) const;
+
+  // Key of a persisted index: it is only reused for the archive it was built from.
+  struct CacheKey {
+    uint64_t archiveSize;
+    int64_t archiveMtime;
+    uint64_t headerHash;
+  };
+
+  // Writes the index to a flat file that load() can map and use as is.
+  void save(const std::string& path, const CacheKey& key) const;
+  // Maps a file written by save(); fails if it is stale, corrupt or for another archive.
+  static bool load(const std::string& path, const CacheKey& key, uint64_t dataOffset, uint64_t fileSize, AsarIndex* out);
+
+  // Builds an open-addressing table keyed on the full normalized path, after
+  // which find() resolves a path with a single probe instead of a walk.
+  void buildHashTable();
+  bool hasHashTable() const;
+
+ private:
+  friend class AsarHeaderParser;
+  friend class AsarNode;
+
+  // A slot matches a path when both hashes and the length of "/a/b" agree,
+  // so a hit is confirmed without walking the node's ancestors. Two 64-bit
+  // hashes colliding together for one length is treated as impossible.
+  struct Slot {
+    uint32_t id;
+    uint32_t length;
+    uint64_t hash;
+    uint64_t check;
+  };
+
+  struct LazySource {
+    std::vector<char> buffer;
+    const char* json;
+    size_t length;
+    // Matching brace offsets of every object, in order of the opening brace.
+    std::vector<uint32_t> opens;
+    std::vector<uint32_t> closes;
+    // Serializes expansions. Lookups only take it for a directory that is not loaded yet.
+    std::mutex mutex;
+    // Per node, set with release once it can be read without the mutex. Directories
+    // keep FLAG_UNLOADED in their flags, so an entry never changes after it is
+    // published, except for the child range written before its flag is set.
+    std::unique_ptr<std::atomic<bool>[]> loaded;
+    size_t capacity;
+    std::atomic<size_t> count;
+  };
+
+  mutable std::vector<Entry> _nodes;
+  mutable std::vector<char> _pool;
+  uint64_t _dataOffset;
+  uint64_t _fileSize;
+  std::vector<Slot> _slots;
+  std::shared_ptr<LazySource> _lazy;
+
+  // Set when the index is served straight from a mapped cache file.
+  std::shared_ptr<MappedFile> _mapping;
+  const Entry* _mappedNodes;
+  size_t _mappedCount;
+  const char* _mappedPool;
+
+  const Entry& _node(uint32_t id) const {
+    return this->_mapping ? this->_mappedNodes[id] : this->_nodes[id];
+  }
+  const char* _string(uint32_t offset) const {
+    return (this->_mapping ? this->_mappedPool : this->_pool.data()) + offset;
+  }
+
+  void _load(uint32_t id) const;
+
+  uint32_t _walk(const PathSegments& segments) const;
+  uint32_t _probe(const PathSegments& segments) const;
+
+  uint32_t _addString(const char* str, size_t length);
+  void _readEntry(Entry& entry, const Json::Value& json);
+};
+
+// Handle to one node of an AsarIndex. It is two words, trivially copyable,
+// and only valid while the index it points into is alive.
+class AsarNode {
+ public:
+  class Iterator {
+   public:
+    Iterator(const AsarIndex* index, uint32_t id): _index(index), _id(id) {}
+    AsarNode operator*() const { return AsarNode(this->_index, this->_id); }
+    Iterator& operator++() { this->_id++; return *this; }
+    bool operator==(const Iterator& other) const { return this->_id == other._id; }
+    bool operator!=(const Iterator& other) const { return this->_id != other._id; }
+   private:
+    const AsarIndex* _index;
+    uint32_t _id;
+  };
+
+  class Range {
+   public:
+    Range(const AsarIndex* index, uint32_t first, uint32_t count): _index(index), _first(first), _count(count) {}
+    Iterator begin() const { return Iterator(this->_index, this->_first); }
+    Iterator end() const { return Iterator(this->_index, this->_first + this->_count); }
+    uint32_t size() const { return this->_count; }
+   private:
+    const AsarIndex* _index;
+    uint32_t _first;
+    uint32_t _count;
+  };
+
+  AsarNode(): _index(nullptr), _id(AsarIndex::npos) {}
+  AsarNode(const AsarIndex* index, uint32_t id): _index(index), _id(id) {}
+
+  bool isNull() const { return this->_id == AsarIndex::npos; }
+  uint32_t id() const { return this->_id; }
+
+  bool isDirectory() const { return this->_has(AsarIndex::FLAG_DIRECTORY); }
+  bool isLink() const { return this->_has(AsarIndex::FLAG_LINK); }
+  bool isFile() const { return !this->isNull() && !this->isDirectory() && !this->isLink(); }
+  bool unpacked() const { return this->_has(AsarIndex::FLAG_UNPACKED); }
+  bool executable() const { return this->_has(AsarIndex::FLAG_EXECUTABLE); }
+
+  uint64_t size() const { return this->isFile() ? this->_entry().size : 0; }
+  // Offset as written in the header, relative to the end of the header.
+  uint64_t offset() const { return this->_has(AsarIndex::FLAG_HAS_OFFSET) ? this->_entry().offset - this->_index->_dataOffset : 0; }
+  // Absolute position of the data in the archive file.
+  uint64_t position() const { return this->_has(AsarIndex::FLAG_HAS_OFFSET) ? this->_entry().offset : 0; }
+
+  const char* name() const { return this->isNull() ? "" : this->_index->name(this->_id); }
+  size_t nameLength() const { return this->isNull() ? 0 : this->_entry().nameLength; }
+  const char* link() const { return this->isLink() ? this->_index->link(this->_id) : ""; }
+  size_t linkLength() const { return this->isLink() ? this->_entry().count : 0; }
+
+  AsarNode parent() const {
+    return this->isNull() ? AsarNode() : AsarNode(this->_index, this->_entry().parent);
+  }
+
+  Range children() const {
+    if (!this->isDirectory()) return Range(this->_index, 0, 0);
+    const AsarIndex::Entry& entry = this->_index->at(this->_id);
+    return Range(this->_index, entry.first, entry.count);
+  }
+
+  Json::Value toJson() const {
+    return this->isNull() ? Json::Value(Json::nullValue) : this->_index->toJsonValue(this->_id);
+  }
+
+ private:
+  const AsarIndex* _index;
+  uint32_t _id;
+
+  // Every field but a directory's child range is final once the node exists.
+  const AsarIndex::Entry& _entry() const { return this->_index->_node(this->_id); }
+  bool _has(uint32_t flag) const { return !this->isNull() && (this->_entry().flags & flag) != 0; }
+};
+
+}
+
+#endif
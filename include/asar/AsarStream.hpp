@@ -0,0 +1,65 @@
+#ifndef __ASAR_STREAM_HPP__
+#define __ASAR_STREAM_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace asar {
+
+class MappedFile;
+class RandomAccessFile;
+
+// Sequential reader over one file in an archive, packed or unpacked, that
+// never holds more than one chunk of it in memory. Like AsarView it keeps
+// what it reads from alive, so it can outlive the Asar that opened it.
+class AsarStream {
+ public:
+  static const size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+  AsarStream();
+
+  bool isOpen() const;
+  uint64_t size() const;
+  uint64_t tell() const;
+  bool eof() const;
+
+  // Returns the number of bytes read, 0 at the end of the file.
+  size_t read(void* buffer, size_t length);
+  // whence is SEEK_SET, SEEK_CUR or SEEK_END; the result is clamped to [0, size].
+  uint64_t seek(int64_t offset, int whence = SEEK_SET);
+
+  // Calls callback(const uint8_t* data, size_t length) for each chunk from the
+  // current position to the end, or until it returns false. Chunks point
+  // straight into the archive when it is mapped. Returns the bytes delivered.
+  template <typename Callable>
+  uint64_t readChunks(const Callable& callback, size_t chunkSize = DEFAULT_CHUNK_SIZE) {
+    std::vector<uint8_t> buffer;
+    uint64_t total = 0;
+    const uint8_t* data = nullptr;
+    size_t length;
+    while ((length = this->_next(&data, chunkSize, &buffer)) > 0) {
+      total += length;
+      if (!callback(data, length)) break;
+    }
+    return total;
+  }
+
+ private:
+  friend class Asar;
+
+  std::shared_ptr<RandomAccessFile> _file;
+  std::shared_ptr<MappedFile> _mapping;
+  uint64_t _base;
+  uint64_t _size;
+  uint64_t _position;
+
+  AsarStream(std::shared_ptr<RandomAccessFile> file, std::shared_ptr<MappedFile> mapping, uint64_t base, uint64_t size);
+  size_t _next(const uint8_t** data, size_t chunkSize, std::vector<uint8_t>* buffer);
+};
+
+}
+
+#endif
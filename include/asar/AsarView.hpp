@@ -0,0 +1,52 @@
+#ifndef __ASAR_VIEW_HPP__
+#define __ASAR_VIEW_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace asar {
+
+// Read-only bytes of one file in an archive. The view shares ownership of
+// whatever backs it (the archive mapping or a buffer of its own), so it
+// stays valid after the archive is closed and is cheap to copy.
+class AsarView {
+ public:
+  AsarView(): _data(nullptr), _size(0), _owner() {}
+  AsarView(const uint8_t* data, size_t size, std::shared_ptr<const void> owner):
+    _data(data), _size(size), _owner(std::move(owner)) {}
+
+  explicit AsarView(std::vector<uint8_t>&& buffer) {
+    std::shared_ptr<std::vector<uint8_t>> owned = std::make_shared<std::vector<uint8_t>>(std::move(buffer));
+    this->_data = owned->data();
+    this->_size = owned->size();
+    this->_owner = owned;
+  }
+
+  const uint8_t* data() const { return this->_data; }
+  size_t size() const { return this->_size; }
+  bool empty() const { return this->_size == 0; }
+  const uint8_t* begin() const { return this->_data; }
+  const uint8_t* end() const { return this->_data + this->_size; }
+  uint8_t operator[](size_t i) const { return this->_data[i]; }
+
+  AsarView subview(size_t offset, size_t length) const {
+    if (offset > this->_size) offset = this->_size;
+    if (length > this->_size - offset) length = this->_size - offset;
+    return AsarView(this->_data + offset, length, this->_owner);
+  }
+
+  std::vector<uint8_t> toVector() const {
+    return std::vector<uint8_t>(this->begin(), this->end());
+  }
+
+ private:
+  const uint8_t* _data;
+  size_t _size;
+  std::shared_ptr<const void> _owner;
+};
+
+}
+
+#endif
@@ -32,16 +32,68 @@ EXTERN_C_START
 struct __asar_context;
 typedef struct __asar_context asar_t;
 
+struct __asar_stream_context;
+typedef struct __asar_stream_context asar_stream_t;
+
 typedef int boolean_t;
 typedef struct asar_node_struct {
   boolean_t is_directory;
-  uint32_t size;
+  uint32_t size; /* 0xFFFFFFFF for files of 4 GiB and more, see asar_node_ex_t */
   uint64_t offset;
   boolean_t unpacked;
   boolean_t executable;
   char link[260];
 } asar_node_t;
 
+/* same as asar_node_t with the full 64-bit size */
+typedef struct asar_node_ex_struct {
+  boolean_t is_directory;
+  uint64_t size;
+  uint64_t offset;
+  boolean_t unpacked;
+  boolean_t executable;
+  char link[260];
+} asar_node_ex_t;
+
+typedef struct asar_cache_stats_struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t bytes;
+  uint64_t entries;
+  uint64_t capacity;
+} asar_cache_stats_t;
+
+typedef enum asar_async_mode {
+  async_off,
+  async_auto, /* io_uring where the kernel supports it, a pread thread pool otherwise */
+  async_thread_pool
+} asar_async_mode;
+
+typedef enum asar_advice {
+  advice_none, /* give the kernel no page cache hints */
+  advice_random, /* scattered reads: no readahead, preload the header and warm_paths */
+  advice_sequential /* reads mostly in archive order: more readahead, preload the header and warm_paths */
+} asar_advice;
+
+typedef struct asar_open_options_struct {
+  boolean_t hash_index; /* ignored when lazy is set */
+  boolean_t lazy;
+  /* keep a mappable copy of the index next to the archive and reuse it while the archive is unchanged, overrides lazy */
+  boolean_t index_cache;
+  const char* index_cache_dir; /* NULL: <asar_path>.idx, only read by asar_open_ex */
+  boolean_t mmap; /* map the archive so packed files are read without a copy */
+  asar_async_mode async_io; /* backend for submitted reads, set up once at open */
+  uint32_t async_queue_depth; /* reads in flight at once, 0: 64 */
+  uint32_t async_buffer_size; /* size of each preallocated read buffer, 0: 128 KiB */
+  uint32_t io_threads; /* threads serving asar_read_file_async, 0: one per core */
+  uint64_t cache_bytes; /* budget for caching the contents of hot files, 0: no cache */
+  asar_advice advice; /* also makes extraction drop the archive pages it copied */
+  const char* const* warm_paths; /* files or directories to preload after open when advice is set, only read by asar_open_ex */
+  uint32_t warm_count;
+  boolean_t record_access; /* remember the order in which files are first read, see asar_write_access_order */
+} asar_open_options_t;
+
 typedef enum asar_status {
   ok,
   unknown,
@@ -55,7 +107,9 @@ typedef enum asar_status {
   file_error
 } asar_status;
 
+ASAR_API void asar_open_options_init(asar_open_options_t*);
 ASAR_API asar_t* asar_open(const char* asar_path);
+ASAR_API asar_t* asar_open_ex(const char* asar_path, const asar_open_options_t* options);
 ASAR_API void asar_close(asar_t*);
 ASAR_API boolean_t asar_is_open(asar_t*);
 ASAR_API const char* asar_get_temp_dir(asar_t*);
@@ -64,19 +118,73 @@ ASAR_API uint32_t asar_get_header_size(asar_t*);
 ASAR_API uint64_t asar_get_file_size(asar_t*);
 ASAR_API int asar_get_header_json_string(asar_t*, boolean_t, char*, size_t);
 ASAR_API asar_status asar_get_node(asar_t*, const char*, asar_node_t*); 
+ASAR_API asar_status asar_get_node_ex(asar_t*, const char*, asar_node_ex_t*);
 ASAR_API boolean_t asar_exists(asar_t*, const char*);
 ASAR_API int asar_read_file(asar_t*, const char*, char*, size_t);
+/* one lookup, read straight into out: copies up to len bytes and *size receives the full file size */
+ASAR_API asar_status asar_read_file_ex(asar_t*, const char* path, char* out, size_t len, uint64_t* size);
+/* copies at most len bytes of the file starting at offset, *read receives the count */
+ASAR_API asar_status asar_read_file_range(asar_t*, const char* path, uint64_t offset, char* out, size_t len, size_t* read);
+/* reads count files in offset order with coalesced I/O: sizes[i] receives the size of paths[i]
+   and, unless outs is NULL, up to lens[i] bytes of it are copied to outs[i] */
+ASAR_API asar_status asar_read_files(asar_t*, const char* const* paths, size_t count, char* const* outs, const size_t* lens, uint64_t* sizes);
+/* chunked reading of one packed or unpacked file, valid until asar_close_stream even if the archive is closed */
+ASAR_API asar_stream_t* asar_open_stream(asar_t*, const char* path);
+ASAR_API uint64_t asar_stream_size(asar_stream_t*);
+ASAR_API size_t asar_stream_read(asar_stream_t*, void* buffer, size_t length);
+ASAR_API uint64_t asar_stream_seek(asar_stream_t*, int64_t offset, int whence);
+ASAR_API void asar_close_stream(asar_stream_t*);
+/* called on an I/O thread; data is only valid during the call and is NULL unless status is ok */
+typedef void (*asar_read_callback_t)(void* user_data, asar_status status, const char* data, size_t size);
+/* queues a read of the whole file and returns without waiting for it; every outcome goes to callback */
+ASAR_API asar_status asar_read_file_async(asar_t*, const char* path, asar_read_callback_t callback, void* user_data);
+ASAR_API void asar_get_cache_stats(asar_t*, asar_cache_stats_t*);
+/* Starts loading the files, or everything under the directories, into the page cache. Missing paths are skipped. */
+ASAR_API void asar_prefetch(asar_t*, const char* const* paths, size_t count);
+/* Writes the files read so far, one path per line in order of first read, for the ordering option of asar_pack_ex. */
+ASAR_API asar_status asar_write_access_order(asar_t*, const char* path);
 ASAR_API void asar_list(asar_t*);
 ASAR_API asar_status asar_extract(asar_t*, const char*, const char*);
 ASAR_API asar_status asar_extract_temp(asar_t*, const char*);
 
 typedef void (*asar_transform_callback_t)(const char* src, const char* tmp_path);
 
+/* Called with the contents of each file, path being its path in the archive. To replace them, point *out at
+   out_size bytes from malloc (freed by the library) and return nonzero; return 0 to keep the file as it is. */
+typedef boolean_t (*asar_buffer_transform_callback_t)(const char* path, const char* data, size_t size, char** out, size_t* out_size, void* user_data);
+
+typedef struct asar_pack_options_struct {
+  const char* unpack; /* glob of files to leave out of the archive */
+  asar_transform_callback_t transform; /* edits a temporary copy of every file, so packing first copies the whole tree */
+  asar_buffer_transform_callback_t transform_buffer; /* replaced contents are held in memory up to write_memory, the rest in a temporary file */
+  void* transform_user_data;
+  /* file listing paths, one per line, whose data goes first in the archive in that order; a directory stands for everything under it */
+  const char* ordering;
+  /* files at least align_min_size bytes (0: none by size) or matching align_glob start on an align boundary in the archive */
+  uint64_t align_min_size;
+  const char* align_glob;
+  uint32_t align; /* rounded up to a power of two, 0: 4096 */
+  uint32_t scan_threads; /* threads listing and statting src, 0: one per core */
+  /* more globs like unpack; a glob without a slash matches file names at any depth */
+  const char* const* unpack_globs;
+  uint32_t unpack_glob_count;
+  /* globs of directories whose whole contents stay out of the archive */
+  const char* const* unpack_dirs;
+  uint32_t unpack_dir_count;
+  /* globs of files and directories left out of both the archive and .unpacked */
+  const char* const* exclude;
+  uint32_t exclude_count;
+  uint32_t write_threads; /* threads reading file data ahead of the archive writer, 0: one per core */
+  uint64_t write_memory; /* cap on data read but not yet written, 0: 64 MiB */
+} asar_pack_options_t;
+
 ASAR_API asar_status asar_get_last_error_code();
 
 ASAR_API const char* asar_get_last_error_message();
 
 ASAR_API asar_status asar_pack(const char* src, const char* dest, const char* unpack, asar_transform_callback_t transform);
+ASAR_API void asar_pack_options_init(asar_pack_options_t*);
+ASAR_API asar_status asar_pack_ex(const char* src, const char* dest, const asar_pack_options_t* options);
 
 EXTERN_C_END
 
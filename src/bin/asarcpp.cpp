@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <cstddef>
+#include <cstdlib>
 #include "toyo/console.hpp"
 #include "asar/asar.h"
 
@@ -42,28 +43,46 @@ static int asar_main(const std::vector<std::string>& args) {
   if (args1 == "pack" || args1 == "p") {
     std::string dir = "";
     std::string output = "";
-    std::string re = "";
+    std::vector<std::string> unpack;
+    std::vector<std::string> unpackDirs;
+    std::vector<std::string> exclude;
+    std::string ordering = "";
+    std::string alignGlob = "";
+    unsigned long long alignSize = 0;
+    unsigned long alignTo = 0;
     size_t argstart = 2;
     if (argc < 3 || args[2] == "") {
       return printRequireArgumentError("dir");
     }
-    if (args[2][0] == '-') {
-      if (args[2] == "-u") {
-        if (argc < 4 || args[3] == "") {
-          return printRequireOptionValueError("-u");
-        } else {
-          re = args[3];
-          argstart = 4;
-        }
+    while (argstart < argc && args[argstart] != "" && args[argstart][0] == '-') {
+      const std::string& option = args[argstart];
+      if (option != "-u" && option != "--unpack" && option != "--unpack-dir" && option != "--exclude" &&
+          option != "--ordering" && option != "--align-glob" && option != "--align-size" && option != "--align-to") {
+        return printUnknownOptionError(option);
+      }
+      if (argc < argstart + 2 || args[argstart + 1] == "") {
+        return printRequireOptionValueError(option);
+      }
+      const std::string& value = args[argstart + 1];
+      if (option == "-u" || option == "--unpack") {
+        unpack.push_back(value);
+      } else if (option == "--unpack-dir") {
+        unpackDirs.push_back(value);
+      } else if (option == "--exclude") {
+        exclude.push_back(value);
+      } else if (option == "--ordering") {
+        ordering = value;
+      } else if (option == "--align-glob") {
+        alignGlob = value;
+      } else if (option == "--align-size") {
+        alignSize = std::strtoull(value.c_str(), nullptr, 10);
       } else {
-        return printUnknownOptionError(args[2]);
+        alignTo = std::strtoul(value.c_str(), nullptr, 10);
       }
+      argstart += 2;
     }
     
     if (argc < argstart + 1 || args[argstart] == "") {
-      if (args[argstart][0] == '-') {
-        return printUnknownOptionError(args[argstart]);
-      }
       return printRequireArgumentError("dir");
     } else {
       dir = args[argstart];
@@ -74,7 +93,26 @@ static int asar_main(const std::vector<std::string>& args) {
       output = args[argstart + 1];
     }
 
-    asar_status r = asar_pack(dir.c_str(), output.c_str(), re == "" ? nullptr : re.c_str(), nullptr);
+    asar_pack_options_t options;
+    asar_pack_options_init(&options);
+    // Every option may be given more than once.
+    std::vector<const char*> unpackGlobs;
+    std::vector<const char*> unpackDirGlobs;
+    std::vector<const char*> excludeGlobs;
+    for (const std::string& glob : unpack) unpackGlobs.push_back(glob.c_str());
+    for (const std::string& glob : unpackDirs) unpackDirGlobs.push_back(glob.c_str());
+    for (const std::string& glob : exclude) excludeGlobs.push_back(glob.c_str());
+    options.unpack_globs = unpackGlobs.data();
+    options.unpack_glob_count = static_cast<uint32_t>(unpackGlobs.size());
+    options.unpack_dirs = unpackDirGlobs.data();
+    options.unpack_dir_count = static_cast<uint32_t>(unpackDirGlobs.size());
+    options.exclude = excludeGlobs.data();
+    options.exclude_count = static_cast<uint32_t>(excludeGlobs.size());
+    options.ordering = ordering == "" ? nullptr : ordering.c_str();
+    options.align_glob = alignGlob == "" ? nullptr : alignGlob.c_str();
+    options.align_min_size = alignSize;
+    options.align = static_cast<uint32_t>(alignTo);
+    asar_status r = asar_pack_ex(dir.c_str(), output.c_str(), &options);
     if (r != ok) {
       toyo::console::error(asar_get_last_error_message());
       return 1;
@@ -194,7 +232,15 @@ void printHelp() {
   console::log("  -h, --help                                display help for command");
   console::log("");
   console::log("Commands:");
-  console::log("  pack|p [-u <glob>] <dir> <output>         create asar archive");
+  console::log("  pack|p [-u <glob>] [--ordering <file>] <dir> <output>");
+  console::log("                                            create asar archive");
+  console::log("    [--unpack-dir <glob>] [--exclude <glob>]");
+  console::log("                                            leave files (-u), whole directories");
+  console::log("                                            (--unpack-dir) out of the archive,");
+  console::log("                                            or skip them (--exclude); repeatable");
+  console::log("    [--align-glob <glob>] [--align-size <bytes>] [--align-to <bytes>]");
+  console::log("                                            start matching files on a 4 KiB");
+  console::log("                                            (or --align-to) boundary");
   console::log("  list|l <archive>                          list files of asar archive");
   console::log("  extract|e [-p <path>] <archive> <dest>    extract files from archive");
 }
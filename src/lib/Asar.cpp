@@ -1,5 +1,12 @@
 #include "asar/Asar.hpp"
 #include "asar/AsarError.hpp"
+#include "AsarIO.hpp"
+#include "AsarAsyncIO.hpp"
+#include "ThreadPool.hpp"
+#include "ContentCache.hpp"
+#include "DirectoryScanner.hpp"
+#include "GlobSet.hpp"
+#include "PackWriter.hpp"
 
 #include "toyo/fs.hpp"
 #include "toyo/path.hpp"
@@ -9,11 +16,44 @@
 #include "pickle/pickle.hpp"
 #include "oid/oid.hpp"
 
+#include <algorithm>
 #include <regex>
 #include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace asar {
 
+// Started on the first asynchronous read, so synchronous users never pay for the threads.
+struct Asar::IOPool {
+  std::mutex mutex;
+  size_t threads;
+  std::unique_ptr<ThreadPool> pool;
+
+  ThreadPool& get() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->pool) this->pool.reset(new ThreadPool(this->threads));
+    return *this->pool;
+  }
+};
+
+// Node ids in order of first read, for writing an ordering file.
+struct Asar::AccessLog {
+  std::mutex mutex;
+  std::unordered_set<uint32_t> seen;
+  std::vector<uint32_t> order;
+};
+
+// Gives the same hint through both ways the archive is read. The mapping
+// goes first, since mapped pages cannot be dropped from the page cache.
+static void adviseArchive(const RandomAccessFile& file, const MappedFile* mapping, uint64_t offset, uint64_t length, Advice advice) {
+  if (mapping != nullptr) mapping->advise(offset, length, advice);
+  file.advise(offset, length, advice);
+}
+
 toyo::path::env_paths Asar::envpaths = toyo::path::env_paths::create("libasar");
 
 void Asar::copyDirectory(const std::string s, const std::string& d, asar_transform_callback_t transform) {
@@ -89,97 +129,222 @@ void Asar::copyFile(const std::string s, const std::string& d, asar_transform_ca
   }
 }
 
-Asar::HeaderInfo Asar::createHeaderInfo(
-  const std::string& dir,
-  const char* unpack,
+// What a glob of the pack options does to the paths it matches.
+// Exclusions are a set of their own, applied by the scanner.
+enum GlobTag : uint32_t {
+  GLOB_UNPACK = 1,
+  GLOB_UNPACK_DIR = 2,
+  GLOB_ALIGN = 4
+};
+
+Asar::HeaderInfo Asar::createHeaderInfo(const std::string& dir, const GlobSet* globs, const GlobSet* exclude, uint32_t threads) {
+  ScannedEntry root = DirectoryScanner::scan(dir, threads, exclude);
+
+  Asar::HeaderInfo info;
+  info.size = 0;
+  info.align = 0;
+  uint64_t offset = 0;
+  std::string realRoot = toyo::fs::realpath(dir);
+  // Nodes are built in place in the header, so nothing is copied between levels.
+  Json::Value& files = (*info.fs.findNode("/"))["files"];
+  Asar::addDirectory(&root, "", realRoot, globs, false, &files, &offset, &info);
+  return info;
+}
+
+void Asar::addDirectory(
+  ScannedEntry* dir,
+  const std::string& dirInAsar,
+  const std::string& realRoot,
+  const GlobSet* globs,
+  bool unpackAll,
+  Json::Value* nodes,
   uint64_t* offset,
-  uint64_t* totalSize,
-  std::vector<FileInfo>* files,
-  const std::string& root) {
-  
-  std::vector<FileInfo> flist;
-  uint64_t poffset = 0;
-  uint64_t ptotalSize = 0;
-  if (offset == nullptr) {
-    offset = &poffset;
-  }
-  if (totalSize == nullptr) {
-    totalSize = &ptotalSize;
-  }
-  if (files == nullptr) {
-    files = &flist;
-  }
-
-  AsarFileSystem asarFs;
-
-  std::string rootDir = root == "" ? dir : root;
-
-  auto walkHandler = [&](const std::string& path) {
-    std::regex re("\\\\");
-    
-    std::string pathInAsar = std::regex_replace(toyo::path::sep + toyo::path::relative(dir, path), re, "/");
-    std::string pathInAsarFull = std::regex_replace(toyo::path::sep + toyo::path::relative(rootDir, path), re, "/");
-    auto stat = toyo::fs::lstat(path);
-
-    if (stat.is_directory()) {
-      AsarFileSystemDirectoryNode node;
-      node.json = Asar::createHeaderInfo(path, unpack, offset, totalSize, files, rootDir).fs.get();
-      asarFs.insertNode(pathInAsar, node);
-    } else {
-      Json::Value node;
-      node["size"] = stat.size;
+  HeaderInfo* info) {
+
+  for (ScannedEntry& entry : dir->children) {
+    std::string pathInAsarFull = dirInAsar + "/" + entry.name;
+    uint32_t tags = globs != nullptr ? globs->match(pathInAsarFull) : 0;
+
+    if (entry.directory) {
+      Json::Value& node = (*nodes)[entry.name];
+      node["files"] = Json::Value(Json::objectValue);
+      bool unpackDir = unpackAll || (tags & GLOB_UNPACK_DIR);
+      // Marked like upstream asar does for --unpack-dir.
+      if (unpackDir) node["unpacked"] = true;
+      Asar::addDirectory(&entry, pathInAsarFull, realRoot, globs, unpackDir, &node["files"], offset, info);
+      continue;
+    }
 
-      if (stat.is_symbolic_link()) {
-        auto link = toyo::path::relative(toyo::fs::realpath(rootDir), toyo::fs::realpath(path));
-        if (link.substr(0, 2) == "..") {
-          throw AsarError(invalid_path, link + ": file links out of the package");
-        }
-        node.removeMember("size");
-        node["link"] = link;
+    Json::Value node;
+    node["size"] = static_cast<Json::UInt64>(entry.size);
+
+    if (entry.symlink) {
+      auto link = toyo::path::relative(realRoot, entry.realpath);
+      if (link.substr(0, 2) == "..") {
+        throw AsarError(invalid_path, link + ": file links out of the package");
       }
+      node.removeMember("size");
+      node["link"] = link;
+    }
 
-      if (unpack != nullptr) {
-        // std::smatch sm;
-        // std::regex unpackRegex(unpack);
-        // if (std::regex_match(pathInAsarFull, sm, unpackRegex)) {
-        //   node["unpacked"] = true;
-        // }
+    if (unpackAll || (tags & GLOB_UNPACK)) {
+      node["unpacked"] = true;
+    }
 
-        if (toyo::path::globrex::match(pathInAsarFull, unpack) || toyo::path::globrex::match(toyo::path::basename(pathInAsarFull), unpack)) {
-          node["unpacked"] = true;
-        }
-      }
+    if (!entry.symlink && ((toyo::process::platform() == "win32" && toyo::path::extname(entry.path) == ".exe") || (toyo::process::platform() != "win32" && (entry.mode & 0100)))) {
+      node["executable"] = true;
+    }
 
-      if (!node.isMember("link") && ((toyo::process::platform() == "win32" && toyo::path::extname(path) == ".exe") || (toyo::process::platform() != "win32" && (stat.mode & 0100)))) {
-        node["executable"] = true;
-      }
+    Asar::FileInfo fileinfo;
+    fileinfo.size = entry.size;
+    fileinfo.offset = *offset;
+    fileinfo.unpacked = node.isMember("unpacked");
+    fileinfo.symlink = entry.symlink && node["link"].asString() != "";
+    fileinfo.alignMatch = (tags & GLOB_ALIGN) != 0;
+    fileinfo.replaced = false;
+    fileinfo.spilled = false;
+    fileinfo.spillOffset = 0;
+    if (!fileinfo.unpacked && !entry.symlink) {
+      node["offset"] = std::to_string(*offset);
+      *offset = *offset + entry.size;
+    }
+    info->size += entry.symlink ? 0 : entry.size;
 
-      if (!node.isMember("unpacked") && !node.isMember("link")) {
-        node["offset"] = std::to_string(*offset);
-        *offset = *offset + stat.size;
-      }
-      AsarFileSystemNode asarnode;
-      asarnode.json = node;
-      asarFs.insertNode(pathInAsar, asarnode);
-      totalSize += (node.isMember("link") ? 0 : stat.size);
+    (*nodes)[entry.name] = std::move(node);
+    fileinfo.path = std::move(entry.path);
+    fileinfo.pathInAsar = std::move(pathInAsarFull);
+    info->files.push_back(std::move(fileinfo));
+  }
 
-      Asar::FileInfo fileinfo;
-      fileinfo.path = path;
-      fileinfo.size = stat.size;
-      fileinfo.unpacked = node.isMember("unpacked") ? node["unpacked"].asBool() : false;
-      fileinfo.symlink = node.isMember("link") ? (node["link"].asString() != "") : false;
+  // The scanned entries are not needed once they are in the header.
+  std::vector<ScannedEntry>().swap(dir->children);
+}
 
-      files->push_back(fileinfo);
+// Copies length bytes of src, from offset on, into a new file at dest.
+static void copyRange(const std::string& src, uint64_t offset, uint64_t length, const std::string& dest) {
+  RandomAccessFile in;
+  OutputFile out;
+  if (!in.open(src) || !out.open(dest)) {
+    throw AsarError(file_error, "Open file failed.");
+  }
+  std::unique_ptr<char[]> buffer(new char[64 * 1024]);
+  while (length > 0) {
+    size_t chunk = static_cast<size_t>(std::min<uint64_t>(length, 64 * 1024));
+    if (in.readAt(buffer.get(), chunk, offset) != chunk || !out.write(buffer.get(), chunk)) {
+      throw AsarError(file_error, "Copy file failed: " + src);
     }
+    offset += chunk;
+    length -= chunk;
+  }
+}
+
+// Files named by an ordering file, in that order, followed by everything else in walk order.
+static std::vector<size_t> readOrdering(const std::string& ordering, const std::vector<std::string>& keys, const std::unordered_map<std::string, size_t>& byKey) {
+  std::ifstream in;
+#ifdef _WIN32
+  in.open(toyo::charset::a2w(ordering), std::wios::in);
+#else
+  in.open(ordering, std::ios::in);
+#endif
+  if (!in.is_open()) {
+    throw AsarError(file_error, "Open ordering file failed: " + ordering);
+  }
+
+  // Packed files sorted by key, so the files under a directory are one run
+  // found by binary search.
+  std::vector<size_t> sorted;
+  sorted.reserve(byKey.size());
+  for (const auto& entry : byKey) sorted.push_back(entry.second);
+  std::sort(sorted.begin(), sorted.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+  std::vector<size_t> order;
+  std::vector<bool> placed(keys.size(), false);
+  auto place = [&](size_t i) {
+    if (placed[i]) return;
+    placed[i] = true;
+    order.push_back(i);
   };
 
-  walkDir(dir, walkHandler);
+  std::string line;
+  while (std::getline(in, line)) {
+    // Same format as upstream asar: anything up to the last colon is ignored.
+    size_t colon = line.rfind(':');
+    if (colon != std::string::npos) line = line.substr(colon + 1);
+    size_t begin = line.find_first_not_of(" \t\r/");
+    if (begin == std::string::npos) continue;
+    size_t end = line.find_last_not_of(" \t\r/");
+    std::string key = line.substr(begin, end - begin + 1);
+
+    auto found = byKey.find(key);
+    if (found != byKey.end()) {
+      place(found->second);
+      continue;
+    }
+    // A directory places every packed file under it, in walk order.
+    std::string prefix = key + "/";
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), prefix, [&keys](size_t i, const std::string& value) { return keys[i] < value; });
+    std::vector<size_t> under;
+    for (; it != sorted.end() && keys[*it].compare(0, prefix.size(), prefix) == 0; ++it) under.push_back(*it);
+    std::sort(under.begin(), under.end());
+    for (size_t i : under) place(i);
+  }
+  in.close();
 
-  Asar::HeaderInfo info;
-  info.fs = asarFs;
-  info.files = *files;
-  info.size = *totalSize;
-  return info;
+  for (size_t i = 0; i < keys.size(); i++) {
+    place(i);
+  }
+  return order;
+}
+
+void Asar::layout(HeaderInfo* info, const asar_pack_options_t& options) {
+  // Keys as an ordering file lists them, without the leading slash.
+  std::vector<std::string> keys(info->files.size());
+  std::unordered_map<std::string, size_t> byKey;
+  for (size_t i = 0; i < info->files.size(); i++) {
+    const FileInfo& file = info->files[i];
+    keys[i] = file.pathInAsar.substr(1);
+    if (!file.unpacked && !file.symlink) byKey[keys[i]] = i;
+  }
+
+  std::vector<size_t> order;
+  if (options.ordering != nullptr) {
+    order = readOrdering(options.ordering, keys, byKey);
+  } else {
+    for (size_t i = 0; i < keys.size(); i++) order.push_back(i);
+  }
+
+  uint64_t boundary = 0;
+  if (options.align_min_size > 0 || options.align_glob != nullptr) {
+    uint64_t requested = options.align == 0 ? 4096 : options.align;
+    boundary = 4;
+    while (boundary < requested) boundary <<= 1;
+  }
+
+  std::vector<FileInfo> files;
+  files.reserve(order.size());
+  uint64_t offset = 0;
+  info->align = 0;
+  for (size_t i : order) {
+    FileInfo file = info->files[i];
+    if (!file.unpacked && !file.symlink) {
+      bool aligned = boundary != 0 && (
+        (options.align_min_size > 0 && file.size >= options.align_min_size) ||
+        file.alignMatch);
+      if (aligned) {
+        offset = (offset + boundary - 1) / boundary * boundary;
+        info->align = static_cast<uint32_t>(boundary);
+      }
+      Json::Value* node = info->fs.findNode(file.pathInAsar);
+      if (node == nullptr) {
+        throw AsarError(invalid_path, "Missing header node: " + file.pathInAsar);
+      }
+      (*node)["offset"] = std::to_string(offset);
+      file.offset = offset;
+      offset += file.size;
+    }
+    files.push_back(file);
+  }
+  info->files.swap(files);
 }
 
 void Asar::pack(
@@ -188,12 +353,111 @@ void Asar::pack(
   const char* unpack,
   asar_transform_callback_t transform
 ) {
-  std::string tmpsrc = toyo::path::join(envpaths.temp, ObjectId().toHexString());
+  asar_pack_options_t options;
+  asar_pack_options_init(&options);
+  options.unpack = unpack;
+  options.transform = transform;
+  Asar::pack(src, dest, options);
+}
 
-  Asar::copyDirectory(src, tmpsrc, transform);
+void Asar::transformFiles(HeaderInfo* info, const asar_pack_options_t& options) {
+  // Replaced contents stay in memory up to the writer's limit. The rest go to
+  // a temporary file, so memory does not grow with the size of the tree.
+  uint64_t budget = options.write_memory != 0 ? options.write_memory : PackWriter::DEFAULT_MEMORY;
+  uint64_t retained = 0;
+  uint64_t spilled = 0;
+  OutputFile spill;
+  for (FileInfo& file : info->files) {
+    if (file.symlink) continue;
+    const std::string& pathInAsar = file.pathInAsar;
+    std::vector<uint8_t> data = toyo::fs::read_file(file.path);
+    char* out = nullptr;
+    size_t outSize = 0;
+    if (!options.transform_buffer(pathInAsar.c_str(), reinterpret_cast<const char*>(data.data()), data.size(), &out, &outSize, options.transform_user_data)) {
+      continue;
+    }
+    std::shared_ptr<const char> owned(out, ::free);
+    Json::Value* node = info->fs.findNode(pathInAsar);
+    if (node == nullptr) {
+      throw AsarError(invalid_path, "Missing header node: " + pathInAsar);
+    }
+    (*node)["size"] = static_cast<Json::UInt64>(outSize);
+    info->size = info->size - file.size + outSize;
+    file.size = outSize;
+    file.replaced = true;
+    if (retained + outSize <= budget) {
+      retained += outSize;
+      file.data = std::move(owned);
+      continue;
+    }
+    if (!spill.isOpen()) {
+      info->spill = toyo::path::join(envpaths.temp, ObjectId().toHexString());
+      if (!spill.open(info->spill)) {
+        throw AsarError(file_error, "Open file failed: " + info->spill);
+      }
+    }
+    if (!spill.write(out, outSize)) {
+      throw AsarError(file_error, "Write file failed: " + info->spill);
+    }
+    file.spilled = true;
+    file.spillOffset = spilled;
+    spilled += outSize;
+  }
+}
+
+void Asar::pack(const std::string& src, const std::string& dest, const asar_pack_options_t& options) {
+  // Files are read straight from src. Only the legacy callback, which edits
+  // files in place, needs a copy of the whole tree.
+  std::string root = toyo::path::resolve(src);
+  std::string tmpsrc = "";
+  HeaderInfo info;
+  auto cleanup = [&tmpsrc, &info]() {
+    if (tmpsrc != "") toyo::fs::remove(tmpsrc);
+    if (info.spill != "") toyo::fs::remove(info.spill);
+  };
+  if (options.transform != nullptr) {
+    tmpsrc = toyo::path::join(envpaths.temp, ObjectId().toHexString());
+    root = tmpsrc;
+    try {
+      Asar::copyDirectory(src, tmpsrc, options.transform);
+    } catch (const std::exception&) {
+      cleanup();
+      throw;
+    }
+  }
+
+  // Every glob of the options goes into one set, so each path is matched once.
+  GlobSet globs;
+  if (options.unpack != nullptr) globs.add(options.unpack, GLOB_UNPACK);
+  for (uint32_t i = 0; i < options.unpack_glob_count; i++) globs.add(options.unpack_globs[i], GLOB_UNPACK);
+  for (uint32_t i = 0; i < options.unpack_dir_count; i++) globs.add(options.unpack_dirs[i], GLOB_UNPACK_DIR);
+  if (options.align_glob != nullptr) globs.add(options.align_glob, GLOB_ALIGN);
+  GlobSet exclude;
+  for (uint32_t i = 0; i < options.exclude_count; i++) exclude.add(options.exclude[i], 1);
 
-  auto info = createHeaderInfo(tmpsrc, unpack);
+  try {
+    info = createHeaderInfo(root, globs.empty() ? nullptr : &globs, exclude.empty() ? nullptr : &exclude, options.scan_threads);
+    if (options.transform_buffer != nullptr) {
+      Asar::transformFiles(&info, options);
+    }
+    if (options.ordering != nullptr || options.align_min_size > 0 || options.align_glob != nullptr || options.transform_buffer != nullptr) {
+      Asar::layout(&info, options);
+    }
+  } catch (const std::exception&) {
+    cleanup();
+    throw;
+  }
   std::string headerString = info.fs.toJson();
+  if (info.align != 0) {
+    // Offsets are relative to the end of the header, so aligned offsets are only aligned in
+    // the file if the header ends on the boundary too. Trailing spaces keep the JSON valid.
+    Pickle probe;
+    probe.WriteString(headerString);
+    uint64_t dataOffset = 8 + probe.size();
+    if (dataOffset % info.align != 0) {
+      headerString.append(static_cast<size_t>(info.align - dataOffset % info.align), ' ');
+    }
+  }
 
   Pickle headerPickle;
   headerPickle.WriteString(headerString);
@@ -203,70 +467,72 @@ void Asar::pack(
 
   toyo::fs::mkdirs(toyo::path::dirname(dest));
 
-  std::ofstream out;
-#ifdef _WIN32
-  out.open(toyo::charset::a2w(dest), std::wios::binary | std::wios::out | std::wios::trunc);
-#else
-  out.open(dest, std::ios::binary | std::ios::out | std::ios::trunc);
-#endif
-
-  if (!out.is_open()) {
-    toyo::fs::remove(tmpsrc);
+  OutputFile out;
+  if (!out.open(dest)) {
+    cleanup();
     throw AsarError(file_error, "Open file failed.");
   }
 
-  out.write(reinterpret_cast<const char*>(sizePickle.data()), sizePickle.size());
-  out.write(reinterpret_cast<const char*>(headerPickle.data()), headerPickle.size());
-
-  for (size_t i = 0; i < info.files.size(); i++) {
-    const auto& file = info.files[i];
-    if (!file.unpacked) {
-      if (file.symlink) {
-        continue;
-      }
+  OutputFile::Buffer header[2] = {
+    { sizePickle.data(), sizePickle.size() },
+    { headerPickle.data(), headerPickle.size() }
+  };
+  std::vector<PackWriter::Source> sources;
+  for (const FileInfo& file : info.files) {
+    if (file.unpacked || file.symlink) continue;
+    PackWriter::Source source;
+    source.path = file.spilled ? info.spill : file.path;
+    source.pathOffset = file.spilled ? file.spillOffset : 0;
+    source.data = file.data.get();
+    source.offset = file.offset;
+    source.size = file.size;
+    sources.push_back(std::move(source));
+  }
+  try {
+    if (!out.write(header, 2)) {
+      throw AsarError(file_error, "Write file failed.");
+    }
+    PackWriter::write(&out, sources, options.write_threads, options.write_memory);
+  } catch (const std::exception&) {
+    out.close();
+    cleanup();
+    throw;
+  }
+  out.close();
 
-      std::ifstream in;
+  try {
+    for (const FileInfo& file : info.files) {
+      if (!file.unpacked) continue;
+      std::string target = toyo::path::join(dest + ".unpacked", file.pathInAsar.substr(1));
+      toyo::fs::mkdirs(toyo::path::dirname(target));
+      if (file.replaced && !file.spilled) {
+        std::ofstream unpacked;
 #ifdef _WIN32
-      in.open(toyo::charset::a2w(file.path), std::wios::binary | std::wios::in);
+        unpacked.open(toyo::charset::a2w(target), std::wios::binary | std::wios::out | std::wios::trunc);
 #else
-      in.open(file.path, std::ios::binary | std::ios::in);
+        unpacked.open(target, std::ios::binary | std::ios::out | std::ios::trunc);
 #endif
-      if (!in.is_open()) {
-        out.close();
-        toyo::fs::remove(tmpsrc);
-        throw AsarError(file_error, "Open file failed.");
-      }
-
-      char buf[128 * 1024];
-
-      while (!in.eof()) {
-        in.read(buf, 128 * 1024);
-        std::streamsize readCount = in.gcount();
-        out.write(buf, readCount);
-        out.flush();
+        if (file.size > 0) unpacked.write(file.data.get(), static_cast<std::streamsize>(file.size));
+        unpacked.close();
+        if (unpacked.fail()) {
+          throw AsarError(file_error, "Write file failed: " + target);
+        }
+      } else if (file.spilled) {
+        copyRange(info.spill, file.spillOffset, file.size, target);
+      } else {
+        toyo::fs::copy_file(file.path, target);
       }
-      in.close();
-    } else {
-      std::string target = toyo::path::join(dest + ".unpacked", toyo::path::relative(tmpsrc, file.path));
-      toyo::fs::mkdirs(toyo::path::dirname(target));
-      toyo::fs::copy_file(file.path, target);
     }
+  } catch (const std::exception&) {
+    cleanup();
+    throw;
   }
 
-  out.close();
-  toyo::fs::remove(tmpsrc);
+  cleanup();
 }
 
 Asar::~Asar() {
-  if (this->_fd != nullptr) {
-    ::fclose(this->_fd);
-    this->_fd = nullptr;
-  }
-  if (this->_tmp != "") {
-    try {
-      toyo::fs::remove(this->_tmp);
-    } catch (const std::exception&) {}
-  }
+  this->_release();
 }
 
 Asar::Asar() {
@@ -274,25 +540,78 @@ Asar::Asar() {
 }
 
 void Asar::open(const std::string& asarPath) {
-  if (this->_fd != nullptr) {
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  this->open(asarPath, options);
+}
+
+void Asar::open(const std::string& asarPath, const asar_open_options_t& options) {
+  if (this->_file != nullptr) {
     this->close();
   }
 
-#ifdef _WIN32
-  this->_fd = ::_wfopen(toyo::charset::a2w(asarPath).c_str(), L"rb+");
-#else
-  this->_fd = ::fopen(asarPath.c_str(), "rb+");
-#endif
-  // ::fseek(this->_fd, 0, SEEK_SET);
-  if (this->_fd == NULL) {
+  this->_options = options;
+  this->_indexCache = "";
+  if (options.index_cache) {
+    if (options.index_cache_dir == nullptr) {
+      this->_indexCache = asarPath + ".idx";
+    } else {
+      std::string resolved = toyo::path::resolve(asarPath);
+      char hash[17];
+      snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(hashBytes(resolved.data(), resolved.size())));
+      this->_indexCache = toyo::path::join(options.index_cache_dir, toyo::path::basename(asarPath) + "-" + hash + ".idx");
+    }
+  }
+  this->_options.index_cache_dir = nullptr;
+  this->_options.warm_paths = nullptr;
+  this->_options.warm_count = 0;
+
+  std::shared_ptr<RandomAccessFile> file = std::make_shared<RandomAccessFile>();
+  if (!file->open(asarPath)) {
     throw AsarError(file_error, "Open asar file failed: " + asarPath);
   }
+  this->_file = file;
 
   this->_src = asarPath;
 
   this->_tmp = toyo::path::join(envpaths.temp, toyo::path::basename(asarPath) + "_" + ObjectId().toHexString());
 
   this->_readInfo();
+  if (options.advice != advice_none) {
+    file->advise(0, this->_fileSize, options.advice == advice_random ? Advice::random : Advice::sequential);
+  }
+
+  if (options.mmap) {
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(asarPath) || mapping->size() != this->_fileSize) {
+      this->close();
+      throw AsarError(file_error, "Map asar file failed: " + asarPath);
+    }
+    this->_mapping = mapping;
+    if (options.advice != advice_none) {
+      // Page faults on a mapping follow the hints of the mapping, not of the file.
+      mapping->advise(0, mapping->size(), options.advice == advice_random ? Advice::random : Advice::sequential);
+    }
+  }
+
+  if (options.cache_bytes > 0) {
+    this->_cache = std::make_shared<ContentCache>(options.cache_bytes);
+  }
+
+  this->_ioPool = std::make_shared<IOPool>();
+  this->_ioPool->threads = options.io_threads;
+
+  if (options.record_access) {
+    this->_accessLog = std::make_shared<AccessLog>();
+  }
+
+  if (options.async_io != async_off) {
+    this->_queue = ReadQueue::create(options.async_io, this->_file, options.async_queue_depth, options.async_buffer_size);
+  }
+
+  if (options.advice != advice_none && options.warm_count > 0) {
+    this->prefetch(std::vector<std::string>(options.warm_paths, options.warm_paths + options.warm_count));
+  }
 }
 
 void Asar::_readInfo() {
@@ -300,8 +619,8 @@ void Asar::_readInfo() {
   bool r = false;
   char headerSize[8];
   size_t readsize = 0;
-  readsize = ::fread(headerSize, 1, 8, this->_fd);
-  if (readsize <= 0) {
+  readsize = this->_file->readAt(headerSize, 8, 0);
+  if (readsize != 8) {
     throw AsarError(invalid_asar, "Invalid asar file.");
   }
   Pickle pickle(headerSize, 8);
@@ -314,52 +633,97 @@ void Asar::_readInfo() {
   if (!r) {
     throw AsarError(invalid_asar, "Invalid asar file. Read header size failed.");
   }
+  if (this->_options.advice != advice_none) {
+    this->_file->advise(8, uHeaderSize, Advice::willNeed);
+  }
 
-  char* headerString = new char[uHeaderSize];
-  memset(headerString, 0, uHeaderSize);
-  readsize = ::fread(headerString, 1, uHeaderSize, this->_fd);
-  if (readsize <= 0) {
+  std::vector<char> header(uHeaderSize);
+  readsize = this->_file->readAt(header.data(), uHeaderSize, 8);
+  if (readsize != uHeaderSize || uHeaderSize < 8) {
     throw AsarError(invalid_asar, "Invalid asar file.");
   }
-  // _begin = ::ftell(this->_fd);
 
-  Pickle pickle2(headerString, uHeaderSize);
-  PickleIterator it2(pickle2);
-  std::string strHeader;
-  r = it2.ReadString(&strHeader);
-  delete[] headerString;
-  if (!r) {
+  // The header pickle holds a single string: uint32 payload size, int32 length, then the bytes.
+  // Read it in place rather than copying it out through PickleIterator.
+  uint32_t payloadSize = 0;
+  int32_t length = 0;
+  memcpy(&payloadSize, header.data(), sizeof(uint32_t));
+  memcpy(&length, header.data() + sizeof(uint32_t), sizeof(int32_t));
+  // payloadSize is checked first, so payloadSize - 4 cannot wrap around.
+  if (payloadSize < 4 || payloadSize > uHeaderSize - 4 || length < 0 ||
+      static_cast<uint32_t>(length) > payloadSize - 4 || static_cast<uint32_t>(length) > uHeaderSize - 8) {
     throw AsarError(invalid_asar, "Invalid asar file. Read header failed.");
   }
 
-  std::istringstream is(strHeader);
-  Json::Value headerJson;
-  is >> headerJson;
-  this->_fs = AsarFileSystem(headerJson);
-
-  try {
-    this->_fileSize = toyo::fs::lstat(this->_src).size;
-  } catch (const std::exception&) {
+  // From the opened file, so an archive reached through a symlink gets its own size.
+  int64_t mtime = 0;
+  if (!this->_file->stat(&this->_fileSize, &mtime)) {
     throw AsarError(invalid_asar, "Read file size failed.");
   }
+
+  uint64_t dataOffset = 8 + static_cast<uint64_t>(uHeaderSize);
+  if (this->_indexCache != "") {
+    AsarIndex::CacheKey key;
+    key.headerHash = hashBytes(header.data(), header.size());
+    key.archiveSize = this->_fileSize;
+    key.archiveMtime = mtime;
+    if (!AsarIndex::load(this->_indexCache, key, dataOffset, this->_fileSize, &this->_index)) {
+      // Stale or missing: parse in full and replace the cache. Failing to write it is not an error.
+      this->_index = AsarIndex::parse(header.data() + 8, static_cast<size_t>(length), dataOffset, this->_fileSize);
+      try {
+        this->_index.save(this->_indexCache, key);
+      } catch (const std::exception&) {}
+    }
+    if (this->_options.hash_index) {
+      this->_index.buildHashTable();
+    }
+    return;
+  }
+
+  if (this->_options.lazy) {
+    this->_index = AsarIndex::parseLazy(std::move(header), 8, static_cast<size_t>(length), dataOffset, this->_fileSize);
+  } else {
+    this->_index = AsarIndex::parse(header.data() + 8, static_cast<size_t>(length), dataOffset, this->_fileSize);
+  }
+  if (this->_options.hash_index) {
+    this->_index.buildHashTable();
+  }
+
 }
 
 void Asar::close() {
-  this->~Asar();
+  this->_release();
   this->_init();
 }
 
-void Asar::_init(const std::string& src, uint32_t headerSize, uint64_t fileSize, AsarFileSystem* fs, const std::string& tmp) {
-  this->_fd = nullptr;
+void Asar::_release() {
+  // Runs the reads still queued before anything they use goes away.
+  this->_ioPool.reset();
+  this->_queue.reset();
+  this->_cache.reset();
+  this->_accessLog.reset();
+  this->_mapping.reset();
+  this->_file.reset();
+  if (this->_tmp != "") {
+    try {
+      toyo::fs::remove(this->_tmp);
+    } catch (const std::exception&) {}
+  }
+}
+
+void Asar::_init(const std::string& src, uint32_t headerSize, uint64_t fileSize, AsarIndex* index, const std::string& tmp) {
+  this->_file.reset();
   this->_src = src;
   this->_headerSize = headerSize;
   this->_fileSize = fileSize;
-  if (fs != nullptr) this->_fs = *fs;
+  this->_index = index != nullptr ? *index : AsarIndex();
   this->_tmp = tmp;
+  this->_indexCache = "";
+  asar_open_options_init(&this->_options);
 }
 
 bool Asar::isOpen() const {
-  return this->_fd != nullptr;
+  return this->_file != nullptr;
 }
 
 const std::string& Asar::getTempDir() const {
@@ -381,55 +745,477 @@ uint32_t Asar::getHeaderSize() const {
 }
 
 std::string Asar::getHeaderJsonString(bool format) const {
-  return this->_fs.toJson(format);
+  return this->_index.toJson(format);
 }
 
 bool Asar::exists(const std::string& path) const {
-  return this->_fs.exists(path);
+  return !this->stat(path).isNull();
 }
 
 std::vector<std::string> Asar::readdir(const std::string& path) const {
-  return this->_fs.readdir(path);
+  return this->_index.readdir(path);
 }
 
 Json::Value Asar::getNode(const std::string& path) const {
-  return this->_fs.getNode(path);
+  return this->stat(path).toJson();
 }
 
-std::vector<uint8_t> Asar::readFile(const std::string& path) const {
-  Json::Value node = this->_fs.getNode(path);
+AsarNode Asar::stat(const std::string& path) const {
+  return AsarNode(&this->_index, this->_index.find(path));
+}
+
+AsarNode Asar::_fileNode(const std::string& path) const {
+  AsarNode node = this->stat(path);
   if (node.isNull()) {
-    throw AsarError(invalid_path, "No such file or directory: " + toyo::path::join(this->_src, path));
+    throw AsarError(not_exists, "No such file or directory: " + toyo::path::join(this->_src, path));
   }
 
-  if (node.isMember("files")) {
-    throw AsarError(invalid_path, "Illegal operation on a directory: " + toyo::path::join(this->_src, path));
+  if (node.isDirectory()) {
+    throw AsarError(not_file, "Illegal operation on a directory: " + toyo::path::join(this->_src, path));
   }
+  this->_recordAccess(node);
+  return node;
+}
 
-  if (node.isMember("unpacked")) {
-    return toyo::fs::read_file(toyo::path::join(this->_src + ".unpacked", path));
+void Asar::_recordAccess(AsarNode node) const {
+  if (!this->_accessLog) return;
+  std::lock_guard<std::mutex> lock(this->_accessLog->mutex);
+  if (this->_accessLog->seen.insert(node.id()).second) {
+    this->_accessLog->order.push_back(node.id());
+  }
+}
+
+std::vector<std::string> Asar::accessOrder() const {
+  std::vector<uint32_t> ids;
+  if (this->_accessLog) {
+    std::lock_guard<std::mutex> lock(this->_accessLog->mutex);
+    ids = this->_accessLog->order;
+  }
+  std::vector<std::string> paths;
+  paths.reserve(ids.size());
+  for (uint32_t id : ids) {
+    std::string path;
+    for (AsarNode node(&this->_index, id); node.id() != 0; node = node.parent()) {
+      path = "/" + std::string(node.name(), node.nameLength()) + path;
+    }
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+void Asar::writeAccessOrder(const std::string& path) const {
+  std::ofstream out;
+#ifdef _WIN32
+  out.open(toyo::charset::a2w(path), std::wios::binary | std::wios::out | std::wios::trunc);
+#else
+  out.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+#endif
+  if (!out.is_open()) {
+    throw AsarError(file_error, "Open file failed: " + path);
+  }
+  for (const std::string& item : this->accessOrder()) {
+    out << item << "\n";
+  }
+}
+
+void Asar::_readPacked(AsarNode node, uint8_t* out, size_t length) const {
+  size_t size = node.size() < length ? static_cast<size_t>(node.size()) : length;
+  if (size == 0) return;
+  if (this->_mapping) {
+    memcpy(out, this->_mapping->data() + node.position(), size);
+    return;
   }
-  uint32_t size = node["size"].asUInt();
-  uint64_t offset = 8 + this->_headerSize + std::strtoull(node["offset"].asString().c_str(), nullptr, 10);
-  uint8_t* buf = new uint8_t[size];
-  long curpos = ::ftell(this->_fd);
-  ::fseek(this->_fd, (long)offset, SEEK_SET);
-  size_t readsize = ::fread(buf, 1, size, this->_fd);
-  if (readsize <= 0) {
-    ::fseek(this->_fd, curpos, SEEK_SET);
-    delete buf;
+  if (this->_file->readAt(out, size, node.position()) != size) {
     throw AsarError(invalid_asar, "Invalid asar file.");
   }
-  ::fseek(this->_fd, curpos, SEEK_SET);
-  std::vector<uint8_t> res(buf, buf + size);
-  delete buf;
+}
+
+std::vector<uint8_t> Asar::readFile(const std::string& path) const {
+  if (this->_cache) {
+    return this->readFileView(path).toVector();
+  }
+  AsarNode node = this->_fileNode(path);
+  if (node.unpacked()) {
+    return toyo::fs::read_file(toyo::path::join(this->_src + ".unpacked", path));
+  }
+  std::vector<uint8_t> res(static_cast<size_t>(node.size()));
+  this->_readPacked(node, res.data(), res.size());
   return res;
 }
 
+// Reads that start within COALESCE_GAP bytes of the previous one are merged,
+// up to COALESCE_LIMIT bytes per read.
+static const uint64_t COALESCE_GAP = 64 * 1024;
+static const uint64_t COALESCE_LIMIT = 8 * 1024 * 1024;
+
+void Asar::_readPackedBatch(const std::vector<AsarNode>& nodes, uint8_t* const* outs, const size_t* lengths) const {
+  struct Request {
+    uint64_t position;
+    size_t length;
+    size_t index;
+  };
+  std::vector<Request> requests;
+  requests.reserve(nodes.size());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (outs[i] == nullptr || nodes[i].unpacked()) continue;
+    size_t length = static_cast<size_t>(nodes[i].size());
+    if (lengths[i] < length) length = lengths[i];
+    if (length == 0) continue;
+    Request request = { nodes[i].position(), length, i };
+    requests.push_back(request);
+  }
+
+  if (this->_mapping) {
+    for (const Request& request : requests) {
+      memcpy(outs[request.index], this->_mapping->data() + request.position, request.length);
+    }
+    return;
+  }
+
+  std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+    return a.position < b.position;
+  });
+
+  std::vector<uint8_t> scratch;
+  size_t i = 0;
+  while (i < requests.size()) {
+    uint64_t begin = requests[i].position;
+    uint64_t end = begin + requests[i].length;
+    size_t j = i + 1;
+    while (j < requests.size() && requests[j].position <= end + COALESCE_GAP) {
+      uint64_t next = std::max(end, requests[j].position + requests[j].length);
+      if (next - begin > COALESCE_LIMIT) break;
+      end = next;
+      j++;
+    }
+
+    if (j == i + 1) {
+      if (this->_file->readAt(outs[requests[i].index], requests[i].length, begin) != requests[i].length) {
+        throw AsarError(invalid_asar, "Invalid asar file.");
+      }
+    } else {
+      size_t span = static_cast<size_t>(end - begin);
+      scratch.resize(span);
+      if (this->_file->readAt(scratch.data(), span, begin) != span) {
+        throw AsarError(invalid_asar, "Invalid asar file.");
+      }
+      for (size_t k = i; k < j; k++) {
+        memcpy(outs[requests[k].index], scratch.data() + (requests[k].position - begin), requests[k].length);
+      }
+    }
+    i = j;
+  }
+}
+
+std::vector<std::vector<uint8_t>> Asar::readFiles(const std::vector<std::string>& paths) const {
+  std::vector<AsarNode> nodes;
+  nodes.reserve(paths.size());
+  for (const std::string& path : paths) {
+    nodes.push_back(this->_fileNode(path));
+  }
+
+  std::vector<std::vector<uint8_t>> res(paths.size());
+  std::vector<uint8_t*> outs(paths.size(), nullptr);
+  std::vector<size_t> lengths(paths.size(), 0);
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (nodes[i].unpacked()) {
+      res[i] = toyo::fs::read_file(toyo::path::join(this->_src + ".unpacked", paths[i]));
+      continue;
+    }
+    res[i].resize(static_cast<size_t>(nodes[i].size()));
+    outs[i] = res[i].data();
+    lengths[i] = res[i].size();
+  }
+  this->_readPackedBatch(nodes, outs.data(), lengths.data());
+  return res;
+}
+
+void Asar::readFiles(const std::vector<std::string>& paths, uint8_t* const* outs, const size_t* lengths, uint64_t* sizes) const {
+  std::vector<AsarNode> nodes;
+  nodes.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    nodes.push_back(this->_fileNode(paths[i]));
+    sizes[i] = nodes[i].size();
+  }
+  if (outs == nullptr) return;
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (!nodes[i].unpacked() || outs[i] == nullptr) continue;
+    std::vector<uint8_t> data = toyo::fs::read_file(toyo::path::join(this->_src + ".unpacked", paths[i]));
+    sizes[i] = data.size();
+    memcpy(outs[i], data.data(), std::min(data.size(), lengths[i]));
+  }
+  this->_readPackedBatch(nodes, outs, lengths);
+}
+
+uint64_t Asar::readFileInto(const std::string& path, void* out, size_t length) const {
+  AsarNode node = this->_fileNode(path);
+  if (this->_cache && out != nullptr) {
+    AsarView view = this->_view(node, path);
+    if (!view.empty()) memcpy(out, view.data(), std::min(view.size(), length));
+    return view.size();
+  }
+  if (!node.unpacked()) {
+    if (out != nullptr) this->_readPacked(node, static_cast<uint8_t*>(out), length);
+    return node.size();
+  }
+
+  std::string target = toyo::path::join(this->_src + ".unpacked", path);
+  RandomAccessFile file;
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  if (!file.open(target) || !statFile(target, &size, &mtime)) {
+    throw AsarError(invalid_path, "Open file failed: " + target);
+  }
+  size_t count = size < length ? static_cast<size_t>(size) : length;
+  if (out != nullptr && count > 0 && file.readAt(out, count, 0) != count) {
+    throw AsarError(file_error, "Read file failed: " + target);
+  }
+  return size;
+}
+
+std::vector<uint8_t> Asar::readFile(const std::string& path, uint64_t offset, size_t length) const {
+  AsarStream stream = this->openStream(path);
+  if (offset >= stream.size()) return std::vector<uint8_t>();
+  uint64_t remaining = stream.size() - offset;
+  std::vector<uint8_t> res(length < remaining ? length : static_cast<size_t>(remaining));
+  stream.seek(static_cast<int64_t>(offset));
+  res.resize(stream.read(res.data(), res.size()));
+  return res;
+}
+
+size_t Asar::readFile(const std::string& path, uint64_t offset, void* out, size_t length) const {
+  AsarStream stream = this->openStream(path);
+  if (offset >= stream.size()) return 0;
+  stream.seek(static_cast<int64_t>(offset));
+  return stream.read(out, length);
+}
+
+AsarView Asar::readFileView(const std::string& path) const {
+  return this->_view(this->_fileNode(path), path);
+}
+
+AsarView Asar::_view(AsarNode node, const std::string& path) const {
+  if (!node.unpacked() && this->_mapping) {
+    return AsarView(this->_mapping->data() + node.position(), static_cast<size_t>(node.size()), this->_mapping);
+  }
+
+  AsarView view;
+  if (this->_cache && this->_cache->get(node.id(), &view)) {
+    return view;
+  }
+  if (node.unpacked()) {
+    view = AsarView(toyo::fs::read_file(toyo::path::join(this->_src + ".unpacked", path)));
+  } else {
+    std::vector<uint8_t> buffer(static_cast<size_t>(node.size()));
+    this->_readPacked(node, buffer.data(), buffer.size());
+    view = AsarView(std::move(buffer));
+  }
+  if (this->_cache) {
+    this->_cache->put(node.id(), view);
+  }
+  return view;
+}
+
+AsarView Asar::mapFile(const std::string& path) const {
+  AsarNode node = this->_fileNode(path);
+  if (node.size() == 0) return AsarView();
+  std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+  if (node.unpacked()) {
+    std::string target = toyo::path::join(this->_src + ".unpacked", path);
+    if (!mapping->open(target)) {
+      throw AsarError(file_error, "Map file failed: " + target);
+    }
+  } else if (!mapping->open(this->_src, node.position(), node.size()) || mapping->size() != node.size()) {
+    throw AsarError(invalid_asar, "Invalid asar file.");
+  }
+  return AsarView(mapping->data(), static_cast<size_t>(mapping->size()), mapping);
+}
+
+asar_cache_stats_t Asar::cacheStats() const {
+  if (this->_cache) {
+    return this->_cache->stats();
+  }
+  asar_cache_stats_t stats;
+  memset(&stats, 0, sizeof(asar_cache_stats_t));
+  return stats;
+}
+
+void Asar::prefetch(const std::vector<std::string>& paths) const {
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  std::vector<std::string> unpacked;
+  for (const std::string& path : paths) {
+    AsarNode node = this->stat(path);
+    if (node.isNull()) continue;
+    this->walk(node, [&](AsarNode item, const std::string& itemPath) -> bool {
+      if (item.isDirectory()) return true;
+      if (item.isLink() || item.size() == 0) return false;
+      if (item.unpacked()) {
+        unpacked.push_back(toyo::path::join(this->_src + ".unpacked", path, itemPath));
+      } else {
+        ranges.push_back(std::make_pair(item.position(), item.size()));
+      }
+      return false;
+    });
+  }
+
+  // One hint per run of nearby files rather than one per file.
+  std::sort(ranges.begin(), ranges.end());
+  size_t i = 0;
+  while (i < ranges.size()) {
+    uint64_t begin = ranges[i].first;
+    uint64_t end = begin + ranges[i].second;
+    for (i++; i < ranges.size() && ranges[i].first <= end + COALESCE_GAP; i++) {
+      end = std::max(end, ranges[i].first + ranges[i].second);
+    }
+    adviseArchive(*this->_file, this->_mapping.get(), begin, end - begin, Advice::willNeed);
+  }
+
+  for (const std::string& path : unpacked) {
+    // The hint outlives the descriptor: pages are read into the shared page cache.
+    RandomAccessFile file;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (statFile(path, &size, &mtime) && file.open(path)) file.advise(0, size, Advice::willNeed);
+  }
+}
+
+AsarStream Asar::openStream(const std::string& path) const {
+  AsarNode node = this->_fileNode(path);
+  if (node.unpacked()) {
+    std::string target = toyo::path::join(this->_src + ".unpacked", path);
+    std::shared_ptr<RandomAccessFile> file = std::make_shared<RandomAccessFile>();
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!file->open(target) || !statFile(target, &size, &mtime)) {
+      throw AsarError(invalid_path, "Open file failed: " + target);
+    }
+    return AsarStream(file, nullptr, 0, size);
+  }
+  return AsarStream(this->_file, this->_mapping, node.position(), node.size());
+}
+
+std::function<std::vector<uint8_t>()> Asar::_reader(const std::string& path) const {
+  AsarNode node = this->_fileNode(path);
+  if (node.unpacked()) {
+    std::string target = toyo::path::join(this->_src + ".unpacked", path);
+    return [target]() {
+      return toyo::fs::read_file(target);
+    };
+  }
+
+  // Only shared handles are captured, so the read does not depend on this Asar staying put.
+  std::shared_ptr<RandomAccessFile> file = this->_file;
+  std::shared_ptr<MappedFile> mapping = this->_mapping;
+  uint64_t position = node.position();
+  size_t size = static_cast<size_t>(node.size());
+  return [file, mapping, position, size]() {
+    std::vector<uint8_t> data(size);
+    if (size == 0) return data;
+    if (mapping) {
+      memcpy(data.data(), mapping->data() + position, size);
+    } else if (file->readAt(data.data(), size, position) != size) {
+      throw AsarError(invalid_asar, "Invalid asar file.");
+    }
+    return data;
+  };
+}
+
+void Asar::readFileAsync(const std::string& path, const ReadCallback& done) const {
+  if (!this->_ioPool) {
+    throw AsarError(file_error, "Asar is not open.");
+  }
+  std::function<std::vector<uint8_t>()> read;
+  std::exception_ptr error;
+  try {
+    read = this->_reader(path);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  // Lookup failures are delivered on the pool as well, so done never runs on the caller's thread.
+  this->_ioPool->get().post([read, error, done]() {
+    std::vector<uint8_t> data;
+    std::exception_ptr failure = error;
+    if (!failure) {
+      try {
+        data = read();
+      } catch (...) {
+        failure = std::current_exception();
+      }
+    }
+    done(failure, data);
+  });
+}
+
+std::future<std::vector<uint8_t>> Asar::readFileAsync(const std::string& path) const {
+  std::shared_ptr<std::promise<std::vector<uint8_t>>> promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+  std::future<std::vector<uint8_t>> future = promise->get_future();
+  this->readFileAsync(path, [promise](std::exception_ptr error, std::vector<uint8_t>& data) {
+    if (error) {
+      promise->set_exception(error);
+    } else {
+      promise->set_value(std::move(data));
+    }
+  });
+  return future;
+}
+
+ReadQueue& Asar::_readQueue() const {
+  if (!this->_queue) {
+    throw AsarError(file_error, "Asar was not opened with async_io.");
+  }
+  return *this->_queue;
+}
+
+void Asar::submitReads(const std::vector<AsarReadRequest>& requests) const {
+  ReadQueue& queue = this->_readQueue();
+  for (const AsarReadRequest& request : requests) {
+    AsarNode node = this->stat(request.path);
+    if (node.isNull() || node.isDirectory()) {
+      queue.fail(request.userData, node.isNull() ? not_exists : not_file);
+      continue;
+    }
+    this->_recordAccess(node);
+
+    std::shared_ptr<RandomAccessFile> file;
+    uint64_t base = node.position();
+    uint64_t size = node.size();
+    if (node.unpacked()) {
+      std::string target = toyo::path::join(this->_src + ".unpacked", request.path);
+      int64_t mtime = 0;
+      file = std::make_shared<RandomAccessFile>();
+      if (!file->open(target) || !statFile(target, &size, &mtime)) {
+        queue.fail(request.userData, file_error);
+        continue;
+      }
+      base = 0;
+    }
+
+    uint64_t length = 0;
+    if (request.offset < size) {
+      length = size - request.offset < request.length ? size - request.offset : request.length;
+    }
+    queue.submit(file, base + request.offset, static_cast<size_t>(length), request.userData);
+  }
+  queue.flush();
+}
+
+size_t Asar::reapReads(std::vector<AsarReadCompletion>* out, size_t minCompletions) const {
+  return this->_readQueue().reap(out, minCompletions);
+}
+
+size_t Asar::pendingReads() const {
+  return this->_queue ? this->_queue->pending() : 0;
+}
+
+const char* Asar::asyncBackend() const {
+  return this->_queue ? this->_queue->backend() : "";
+}
+
 std::vector<std::string> Asar::list() const {
   std::vector<std::string> res;
   std::regex re("\\\\");
-  this->walk(this->_fs.get(), [&](const Json::Value&, const std::string& name) {
+  this->walk(AsarNode(&this->_index, 0), [&](AsarNode, const std::string& name) {
     res.push_back(std::regex_replace(name, re, "/"));
     return true;
   }, "/");
@@ -441,17 +1227,16 @@ void Asar::extract(const std::string& p, const std::string& dest) const {
   std::regex re("\\\\");
   std::string path = std::regex_replace(p, re, "/");
 
-  Json::Value node = this->_fs.getNode(path);
+  AsarNode node = this->stat(path);
   if (node.isNull()) {
     throw AsarError(invalid_path, "No such file or directory: " + toyo::path::join(this->_src, path));
   }
 
   std::string target = toyo::path::join(dest, toyo::path::basename(path));
 
-  if (node.isMember("files")) {
-    auto files = node["files"].getMemberNames();
-    for (const std::string& name : files) {
-      this->extract(toyo::path::join(path, name), target);
+  if (node.isDirectory()) {
+    for (AsarNode child : node.children()) {
+      this->extract(toyo::path::join(path, std::string(child.name(), child.nameLength())), target);
     }
     return;
   }
@@ -459,13 +1244,13 @@ void Asar::extract(const std::string& p, const std::string& dest) const {
   auto dir = toyo::path::dirname(target);
   if (!toyo::fs::exists(dir)) toyo::fs::mkdirs(dir);
 
-  if (node.isMember("unpacked")) {
+  if (node.unpacked()) {
     toyo::fs::copy_file(toyo::path::join(this->_src + ".unpacked", path), target);
     return;
   }
 
-  if (node.isMember("link")) {
-    auto link = node["link"].asString();
+  if (node.isLink()) {
+    std::string link(node.link(), node.linkLength());
     if (toyo::process::platform() == "win32") {
       this->extract(link, dest);
       toyo::fs::rename(toyo::path::join(dest, toyo::path::basename(link)), target);
@@ -494,27 +1279,30 @@ void Asar::extract(const std::string& p, const std::string& dest) const {
     throw AsarError(invalid_path, "Cannot write target file.");
   }
 
+  uint64_t size = node.size();
+  uint64_t offset = node.position();
+  if (this->_mapping) {
+    ::fwrite(this->_mapping->data() + offset, sizeof(uint8_t), static_cast<size_t>(size), df);
+    size = 0;
+  }
   uint8_t buf[128 * 1024];
-  long curpos = ::ftell(this->_fd);
-  size_t read;
-  uint32_t size = node["size"].asUInt();
-  uint64_t offset = 8 + this->_headerSize + std::strtoull(node["offset"].asString().c_str(), nullptr, 10);
-  ::fseek(this->_fd, (long)offset, SEEK_SET);
-  size_t total = 0;
-  while ((read = ::fread(buf, sizeof(uint8_t), 128 * 1024, this->_fd)) > 0) {
-    total += read;
-
-    if (total >= size) {
-      ::fwrite(buf, sizeof(uint8_t), read - (total - size), df);
-      ::fflush(df);
-      break;
-    } else {
-      ::fwrite(buf, sizeof(uint8_t), read, df);
-      ::fflush(df);
-    }
+  while (size > 0) {
+    size_t chunk = size < sizeof(buf) ? static_cast<size_t>(size) : sizeof(buf);
+    size_t read = this->_file->readAt(buf, chunk, offset);
+    if (read == 0) break;
+    ::fwrite(buf, sizeof(uint8_t), read, df);
+    offset += read;
+    size -= read;
   }
 
   ::fclose(df);
+  if (size > 0) {
+    throw AsarError(invalid_asar, "Invalid asar file.");
+  }
+  if (this->_options.advice != advice_none && node.size() > 0) {
+    // Extraction reads each byte once; leave the page cache to files that are read again.
+    adviseArchive(*this->_file, this->_mapping.get(), node.position(), node.size(), Advice::dontNeed);
+  }
 }
 
 void Asar::extractTemp(const std::string& path) const {
@@ -0,0 +1,435 @@
+#include "AsarAsyncIO.hpp"
+#include "AsarIO.hpp"
+#include "ThreadPool.hpp"
+#include "asar/AsarError.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASAR_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef ASAR_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace asar {
+
+static const size_t POOL_ALIGNMENT = 4096;
+
+BufferPool::BufferPool(size_t count, size_t bufferSize):
+  _memory(count * bufferSize + POOL_ALIGNMENT), _base(nullptr), _count(count), _bufferSize(bufferSize), _free(), _mutex() {
+  uintptr_t address = reinterpret_cast<uintptr_t>(this->_memory.data());
+  this->_base = this->_memory.data() + ((POOL_ALIGNMENT - address % POOL_ALIGNMENT) % POOL_ALIGNMENT);
+  this->_free.reserve(count);
+  for (size_t i = count; i > 0; i--) {
+    this->_free.push_back(static_cast<int>(i - 1));
+  }
+}
+
+size_t BufferPool::count() const {
+  return this->_count;
+}
+
+size_t BufferPool::bufferSize() const {
+  return this->_bufferSize;
+}
+
+uint8_t* BufferPool::at(size_t index) {
+  return this->_base + index * this->_bufferSize;
+}
+
+int BufferPool::acquire() {
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  if (this->_free.empty()) return -1;
+  int index = this->_free.back();
+  this->_free.pop_back();
+  return index;
+}
+
+std::shared_ptr<const void> BufferPool::lease(int index) {
+  std::shared_ptr<BufferPool> self = this->shared_from_this();
+  return std::shared_ptr<const void>(this->at(index), [self, index](const void*) {
+    std::lock_guard<std::mutex> lock(self->_mutex);
+    self->_free.push_back(index);
+  });
+}
+
+ReadQueue::ReadQueue(const std::shared_ptr<RandomAccessFile>& archive, uint32_t depth, uint32_t bufferSize):
+  _archive(archive),
+  _pool(std::make_shared<BufferPool>(depth, bufferSize)),
+  _depth(depth),
+  _inflight(0),
+  _pending(0),
+  _backlog(),
+  _finished(),
+  _submitMutex(),
+  _reapMutex() {}
+
+ReadQueue::~ReadQueue() {
+  for (Op* op : this->_backlog) delete op;
+  for (Op* op : this->_finished) delete op;
+}
+
+void ReadQueue::submit(const std::shared_ptr<RandomAccessFile>& file, uint64_t offset, size_t length, uint64_t userData) {
+  Op* op = new Op();
+  op->file = file ? file : this->_archive;
+  op->archive = !file;
+  op->offset = offset;
+  op->length = length;
+  op->done = 0;
+  op->buffer = nullptr;
+  op->bufferIndex = -1;
+  op->userData = userData;
+  op->status = ok;
+  op->error = 0;
+
+  if (length > 0) {
+    int index = length <= this->_pool->bufferSize() ? this->_pool->acquire() : -1;
+    if (index >= 0) {
+      op->buffer = this->_pool->at(index);
+      op->bufferIndex = index;
+      op->owner = this->_pool->lease(index);
+    } else {
+      std::shared_ptr<std::vector<uint8_t>> heap = std::make_shared<std::vector<uint8_t>>(length);
+      op->buffer = heap->data();
+      op->owner = heap;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(this->_submitMutex);
+  this->_pending++;
+  if (length == 0) {
+    this->_finished.push_back(op);
+  } else {
+    this->_backlog.push_back(op);
+  }
+}
+
+void ReadQueue::fail(uint64_t userData, asar_status status) {
+  Op* op = new Op();
+  op->archive = false;
+  op->offset = 0;
+  op->length = 0;
+  op->done = 0;
+  op->buffer = nullptr;
+  op->bufferIndex = -1;
+  op->userData = userData;
+  op->status = status;
+  op->error = 0;
+
+  std::lock_guard<std::mutex> lock(this->_submitMutex);
+  this->_pending++;
+  this->_finished.push_back(op);
+}
+
+void ReadQueue::flush() {
+  std::lock_guard<std::mutex> lock(this->_submitMutex);
+  this->_startBacklog();
+}
+
+void ReadQueue::_startBacklog() {
+  bool started = false;
+  while (this->_inflight < this->_depth && !this->_backlog.empty()) {
+    Op* op = this->_backlog.front();
+    this->_backlog.pop_front();
+    this->_inflight++;
+    this->_start(op);
+    started = true;
+  }
+  if (started) this->_commit();
+}
+
+size_t ReadQueue::pending() const {
+  std::lock_guard<std::mutex> lock(this->_submitMutex);
+  return this->_pending;
+}
+
+AsarReadCompletion ReadQueue::_complete(Op* op) {
+  AsarReadCompletion completion;
+  completion.userData = op->userData;
+  completion.status = op->status;
+  completion.systemError = op->error;
+  if (op->status == ok) {
+    completion.data = AsarView(op->buffer, op->length, op->owner);
+  }
+  delete op;
+  return completion;
+}
+
+size_t ReadQueue::reap(std::vector<AsarReadCompletion>* out, size_t minCompletions) {
+  std::lock_guard<std::mutex> reapLock(this->_reapMutex);
+  size_t collected = 0;
+  std::vector<Result> results;
+
+  for (;;) {
+    std::vector<Op*> finished;
+    size_t inflight;
+    {
+      std::lock_guard<std::mutex> lock(this->_submitMutex);
+      finished.swap(this->_finished);
+      this->_pending -= finished.size();
+      inflight = this->_inflight;
+    }
+    for (Op* op : finished) {
+      out->push_back(ReadQueue::_complete(op));
+      collected++;
+    }
+    if (collected >= minCompletions || inflight == 0) break;
+
+    results.clear();
+    this->_wait(&results, 1);
+
+    std::lock_guard<std::mutex> lock(this->_submitMutex);
+    bool restarted = false;
+    for (const Result& result : results) {
+      Op* op = result.first;
+      if (result.second > 0) {
+        op->done += static_cast<size_t>(result.second);
+        if (op->done < op->length) {
+          // Short read: ask for the rest.
+          this->_start(op);
+          restarted = true;
+          continue;
+        }
+      } else {
+        op->status = file_error;
+        op->error = result.second < 0 ? static_cast<int>(-result.second) : EIO;
+      }
+      this->_inflight--;
+      this->_finished.push_back(op);
+    }
+    if (restarted) this->_commit();
+    this->_startBacklog();
+  }
+  return collected;
+}
+
+void ReadQueue::_drain() {
+  std::vector<AsarReadCompletion> discarded;
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(this->_submitMutex);
+      for (Op* op : this->_backlog) delete op;
+      this->_backlog.clear();
+      if (this->_inflight == 0) return;
+    }
+    this->reap(&discarded, 1);
+    discarded.clear();
+  }
+}
+
+// Portable backend: blocking positional reads on a thread pool.
+class ThreadPoolReadQueue : public ReadQueue {
+ public:
+  ThreadPoolReadQueue(const std::shared_ptr<RandomAccessFile>& archive, uint32_t depth, uint32_t bufferSize):
+    ReadQueue(archive, depth, bufferSize), _results(), _mutex(), _ready(), _workers(std::min<size_t>(depth, ThreadPool::defaultSize())) {}
+
+  ~ThreadPoolReadQueue() {
+    this->_drain();
+  }
+
+  const char* backend() const {
+    return "thread pool";
+  }
+
+ protected:
+  void _start(Op* op) {
+    this->_workers.post([this, op]() {
+      size_t length = op->length - op->done;
+      size_t read = op->file->readAt(op->buffer + op->done, length, op->offset + op->done);
+      {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_results.push_back(Result(op, static_cast<int64_t>(read)));
+      }
+      this->_ready.notify_one();
+    });
+  }
+
+  void _commit() {}
+
+  void _wait(std::vector<Result>* results, size_t min) {
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_ready.wait(lock, [this, min]() { return this->_results.size() >= min; });
+    results->insert(results->end(), this->_results.begin(), this->_results.end());
+    this->_results.clear();
+  }
+
+ private:
+  std::vector<Result> _results;
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  // Declared last so its workers are joined before the members they use go away.
+  ThreadPool _workers;
+};
+
+#ifdef ASAR_HAVE_IO_URING
+
+// Linux io_uring backend. The archive descriptor and the buffer pool are
+// registered with the ring once, so reads of packed entries into pool
+// buffers go through IORING_OP_READ_FIXED on a fixed file.
+class UringReadQueue : public ReadQueue {
+ public:
+  UringReadQueue(const std::shared_ptr<RandomAccessFile>& archive, uint32_t depth, uint32_t bufferSize):
+    ReadQueue(archive, depth, bufferSize),
+    _ring(-1), _ringMap(MAP_FAILED), _ringMapSize(0), _sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), _sqesSize(0),
+    _fixedFile(false), _fixedBuffers(false), _unsubmitted(0) {}
+
+  ~UringReadQueue() {
+    if (this->_ring >= 0) this->_drain();
+    if (this->_sqes != MAP_FAILED) ::munmap(this->_sqes, this->_sqesSize);
+    if (this->_ringMap != MAP_FAILED) ::munmap(this->_ringMap, this->_ringMapSize);
+    if (this->_ring >= 0) ::close(this->_ring);
+  }
+
+  const char* backend() const {
+    return "io_uring";
+  }
+
+  bool init(uint32_t depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(io_uring_params));
+    int ring = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+    if (ring < 0) return false;
+    this->_ring = ring;
+    // A single mapping for both rings keeps this simple; older kernels fall back to the thread pool.
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !this->_supportsRead()) return false;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    this->_ringMapSize = sqSize > cqSize ? sqSize : cqSize;
+    this->_ringMap = ::mmap(nullptr, this->_ringMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    if (this->_ringMap == MAP_FAILED) return false;
+    this->_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, this->_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    this->_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* base = static_cast<char*>(this->_ringMap);
+    this->_sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    this->_sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    this->_sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    this->_cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    this->_cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    this->_cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    this->_cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // Registration is an optimization: without it the same reads go through plain descriptors and buffers.
+    int fd = this->_archive->fd();
+    this->_fixedFile = ::syscall(__NR_io_uring_register, ring, IORING_REGISTER_FILES, &fd, 1) == 0;
+    std::vector<iovec> iovecs(this->_pool->count());
+    for (size_t i = 0; i < iovecs.size(); i++) {
+      iovecs[i].iov_base = this->_pool->at(i);
+      iovecs[i].iov_len = this->_pool->bufferSize();
+    }
+    this->_fixedBuffers = ::syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>(iovecs.size())) == 0;
+    return true;
+  }
+
+ protected:
+  void _start(Op* op) {
+    unsigned tail = *this->_sqTail;
+    unsigned index = tail & this->_sqMask;
+    io_uring_sqe* sqe = &this->_sqes[index];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+
+    size_t remaining = op->length - op->done;
+    sqe->opcode = (op->bufferIndex >= 0 && this->_fixedBuffers) ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    if (op->archive && this->_fixedFile) {
+      sqe->fd = 0;
+      sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+      sqe->fd = op->file->fd();
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(op->buffer + op->done);
+    sqe->len = static_cast<uint32_t>(remaining < 0x40000000 ? remaining : 0x40000000);
+    sqe->off = op->offset + op->done;
+    sqe->buf_index = static_cast<uint16_t>(op->bufferIndex >= 0 ? op->bufferIndex : 0);
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+    this->_sqArray[index] = index;
+    __atomic_store_n(this->_sqTail, tail + 1, __ATOMIC_RELEASE);
+    this->_unsubmitted++;
+  }
+
+  void _commit() {
+    while (this->_unsubmitted > 0) {
+      long submitted = ::syscall(__NR_io_uring_enter, this->_ring, this->_unsubmitted, 0, 0, nullptr, 0);
+      if (submitted < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+        throw AsarError(file_error, std::string("io_uring_enter failed: ") + strerror(errno));
+      }
+      this->_unsubmitted -= static_cast<unsigned>(submitted);
+    }
+  }
+
+  void _wait(std::vector<Result>* results, size_t min) {
+    size_t found = 0;
+    for (;;) {
+      unsigned head = *this->_cqHead;
+      unsigned tail = __atomic_load_n(this->_cqTail, __ATOMIC_ACQUIRE);
+      while (head != tail) {
+        io_uring_cqe* cqe = &this->_cqes[head & this->_cqMask];
+        results->push_back(Result(reinterpret_cast<Op*>(cqe->user_data), cqe->res));
+        head++;
+        found++;
+      }
+      __atomic_store_n(this->_cqHead, head, __ATOMIC_RELEASE);
+      if (found >= min) return;
+      long r = ::syscall(__NR_io_uring_enter, this->_ring, 0, static_cast<unsigned>(min - found), IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        throw AsarError(file_error, std::string("io_uring_enter failed: ") + strerror(errno));
+      }
+    }
+  }
+
+ private:
+  int _ring;
+  void* _ringMap;
+  size_t _ringMapSize;
+  io_uring_sqe* _sqes;
+  size_t _sqesSize;
+  unsigned* _sqTail;
+  unsigned _sqMask;
+  unsigned* _sqArray;
+  unsigned* _cqHead;
+  unsigned* _cqTail;
+  unsigned _cqMask;
+  io_uring_cqe* _cqes;
+  bool _fixedFile;
+  bool _fixedBuffers;
+  unsigned _unsubmitted;
+
+  bool _supportsRead() {
+    size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<uint8_t> memory(size, 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(memory.data());
+    if (::syscall(__NR_io_uring_register, this->_ring, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+    return probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+  }
+};
+
+#endif
+
+std::unique_ptr<ReadQueue> ReadQueue::create(asar_async_mode mode, const std::shared_ptr<RandomAccessFile>& archive, uint32_t depth, uint32_t bufferSize) {
+  if (depth == 0) depth = 64;
+  if (bufferSize == 0) bufferSize = 128 * 1024;
+#ifdef ASAR_HAVE_IO_URING
+  if (mode == async_auto) {
+    std::unique_ptr<UringReadQueue> uring(new UringReadQueue(archive, depth, bufferSize));
+    if (uring->init(depth)) return std::unique_ptr<ReadQueue>(uring.release());
+  }
+#endif
+  return std::unique_ptr<ReadQueue>(new ThreadPoolReadQueue(archive, depth, bufferSize));
+}
+
+}
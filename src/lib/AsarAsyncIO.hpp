@@ -0,0 +1,107 @@
+#ifndef __ASAR_ASYNC_IO_HPP__
+#define __ASAR_ASYNC_IO_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "asar/asar.h"
+#include "asar/AsarAsync.hpp"
+
+namespace asar {
+
+class RandomAccessFile;
+
+// Fixed-size read buffers allocated once, so a backend can register them
+// with the kernel. A completion holds its buffer until its view is dropped.
+class BufferPool : public std::enable_shared_from_this<BufferPool> {
+ public:
+  BufferPool(size_t count, size_t bufferSize);
+
+  size_t count() const;
+  size_t bufferSize() const;
+  uint8_t* at(size_t index);
+  // Returns -1 when every buffer is in use.
+  int acquire();
+  std::shared_ptr<const void> lease(int index);
+
+ private:
+  std::vector<uint8_t> _memory;
+  uint8_t* _base;
+  size_t _count;
+  size_t _bufferSize;
+  std::vector<int> _free;
+  std::mutex _mutex;
+};
+
+// Queue of asynchronous reads from an archive and its unpacked files. At
+// most depth reads are in flight; the rest wait in a backlog. submit and
+// reap may be called from different threads.
+class ReadQueue {
+ public:
+  static std::unique_ptr<ReadQueue> create(asar_async_mode mode, const std::shared_ptr<RandomAccessFile>& archive, uint32_t depth, uint32_t bufferSize);
+  virtual ~ReadQueue();
+
+  virtual const char* backend() const = 0;
+
+  // Queues a read of length bytes at offset. A null file means the archive.
+  void submit(const std::shared_ptr<RandomAccessFile>& file, uint64_t offset, size_t length, uint64_t userData);
+  // Queues a completion that failed before any I/O.
+  void fail(uint64_t userData, asar_status status);
+  // Starts everything submitted so far.
+  void flush();
+  // Waits for at least minCompletions (bounded by what is pending) and appends every finished read to out.
+  size_t reap(std::vector<AsarReadCompletion>* out, size_t minCompletions);
+  size_t pending() const;
+
+ protected:
+  struct Op {
+    std::shared_ptr<RandomAccessFile> file;
+    bool archive;
+    uint64_t offset;
+    size_t length;
+    size_t done;
+    uint8_t* buffer;
+    int bufferIndex;
+    std::shared_ptr<const void> owner;
+    uint64_t userData;
+    asar_status status;
+    int error;
+  };
+  // Bytes read by one step of an op, or -errno.
+  typedef std::pair<Op*, int64_t> Result;
+
+  ReadQueue(const std::shared_ptr<RandomAccessFile>& archive, uint32_t depth, uint32_t bufferSize);
+
+  std::shared_ptr<RandomAccessFile> _archive;
+  std::shared_ptr<BufferPool> _pool;
+
+  // Starts reading op->length - op->done bytes into op->buffer + op->done. Called with the submit lock held.
+  virtual void _start(Op* op) = 0;
+  // Hands started reads to the backend. Called with the submit lock held.
+  virtual void _commit() = 0;
+  // Blocks until at least min results are available and appends them. Called with the reap lock held.
+  virtual void _wait(std::vector<Result>* results, size_t min) = 0;
+  // Waits for every read in flight. Backends call it first in their destructors.
+  void _drain();
+
+ private:
+  size_t _depth;
+  size_t _inflight;
+  size_t _pending;
+  std::deque<Op*> _backlog;
+  std::vector<Op*> _finished;
+  mutable std::mutex _submitMutex;
+  std::mutex _reapMutex;
+
+  void _startBacklog();
+  static AsarReadCompletion _complete(Op* op);
+};
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include "json/json.h"
 #include "asar/AsarFileSystem.hpp"
 #include "asar/AsarError.hpp"
+#include "AsarPath.hpp"
 
 #include <cstddef>
 #include <cstdio>
@@ -41,33 +42,6 @@ AsarFileSystemFileNode::AsarFileSystemFileNode(const std::string& link): AsarFil
   json["link"] = link;
 }
 
-std::vector<std::string> AsarFileSystem::split(const std::string& self, const std::string& separator, int limit) {
-  std::string copy = self;
-  char* copyBuf = new char[copy.size() + 1];
-  memset(copyBuf, 0, (copy.size() + 1) * sizeof(char));
-  strcpy(copyBuf, copy.c_str());
-#ifdef _MSC_VER
-  char* tokenPtr = strtok(copyBuf, separator.c_str());
-#else
-  char* buffer;
-  char* tokenPtr = strtok_r(copyBuf, separator.c_str(), &buffer);
-#endif
-  std::vector<std::string> res;
-  while (tokenPtr != NULL && (limit == -1 ? true : ((int)res.size()) < limit)) {
-    res.push_back(tokenPtr);
-#ifdef _MSC_VER
-    tokenPtr = strtok(NULL, separator.c_str());
-#else
-    tokenPtr = strtok_r(NULL, separator.c_str(), &buffer);
-#endif
-  }
-  if (copyBuf[copy.size() - 1] == '\0') {
-    res.push_back("");
-  }
-  delete[] copyBuf;
-  return res;
-}
-
 AsarFileSystem::AsarFileSystem(): header() {
   header["files"] = Json::Value(Json::objectValue);
 }
@@ -88,22 +62,19 @@ const Json::Value& AsarFileSystem::get() const {
 
 void AsarFileSystem::insertNode(const std::string& path, const AsarFileSystemNode& node) {
   if (path == "") throw AsarError(invalid_path, "Cannot insert empty path.");
-  std::string p = toyo::path::join(path);
+  PathSegments paths(path);
+  if (paths.empty()) throw AsarError(invalid_path, "Cannot insert root path.");
 
-  if (p[0] == '/' || p[0] == '\\') p = p.substr(1);
-  if (p == "" || p == ".") throw AsarError(invalid_path, "Cannot insert root path.");
-
-  auto paths = split(p, toyo::path::sep);
   Json::Value* pointer = &(this->header["files"]);
 
   std::string currentName;
   for (size_t i = 0; i < paths.size() - 1; i++) {
-    currentName = paths[i];
+    currentName.assign(paths[i].data, paths[i].length);
     if (pointer->isMember(currentName)) {
       if (pointer->operator[](currentName).isMember("files")) {
         pointer = &(pointer->operator[](currentName)["files"]);
       } else {
-        throw AsarError(invalid_path, "Invalid path: " + p);
+        throw AsarError(invalid_path, "Invalid path: " + path);
       }
     } else {
       Json::Value json;
@@ -113,41 +84,33 @@ void AsarFileSystem::insertNode(const std::string& path, const AsarFileSystemNod
     }
   }
 
-  std::string basename = paths[paths.size() - 1];
+  std::string basename(paths[paths.size() - 1].data, paths[paths.size() - 1].length);
   if (pointer->isMember(basename)) {
-    throw AsarError(invalid_path, "Existing path: " + p);
+    throw AsarError(invalid_path, "Existing path: " + path);
   }
   pointer->operator[](basename) = node.json;
 }
 
 void AsarFileSystem::removeNode(const std::string& path) {
   if (path == "") throw AsarError(invalid_path, "Cannot remove empty path.");
-  std::string p = toyo::path::join(path);
-
-  if (p[0] == '/' || p[0] == '\\') p = p.substr(1);
-  if (p == "" || p == ".") {
+  PathSegments paths(path);
+  if (paths.empty()) {
     this->header["files"] = Json::Value(Json::objectValue);
     return;
   }
 
-  auto paths = split(p, toyo::path::sep);
   Json::Value* pointer = &(this->header["files"]);
 
-  std::string currentName;
   for (size_t i = 0; i < paths.size() - 1; i++) {
-    currentName = paths[i];
-    if (pointer->isMember(currentName)) {
-      if (pointer->operator[](currentName).isMember("files")) {
-        pointer = &(pointer->operator[](currentName)["files"]);
-      } else {
-        return;
-      }
-    } else {
+    const PathSegment& segment = paths[i];
+    const Json::Value* child = pointer->find(segment.data, segment.data + segment.length);
+    if (child == nullptr || !child->isMember("files")) {
       return;
     }
+    pointer = &(pointer->operator[](std::string(segment.data, segment.length))["files"]);
   }
 
-  std::string basename = paths[paths.size() - 1];
+  std::string basename(paths[paths.size() - 1].data, paths[paths.size() - 1].length);
   if (pointer->isMember(basename)) {
     pointer->removeMember(basename);
   }
@@ -155,36 +118,52 @@ void AsarFileSystem::removeNode(const std::string& path) {
 
 Json::Value AsarFileSystem::getNode(const std::string& path) const {
   if (path == "") return Json::Value(Json::nullValue);
-  std::string p = toyo::path::join(path);
-
-  if (p[0] == '/' || p[0] == '\\') p = p.substr(1);
-  if (p == "" || p == ".") return this->header;
+  PathSegments paths(path);
+  if (paths.empty()) return this->header;
 
-  auto paths = split(p, toyo::path::sep);
   const Json::Value* pointer = &(this->header["files"]);
 
-  std::string currentName;
   for (size_t i = 0; i < paths.size() - 1; i++) {
-    currentName = paths[i];
-    if (pointer->isMember(currentName)) {
-      if (pointer->operator[](currentName).isMember("files")) {
-        pointer = &(pointer->operator[](currentName)["files"]);
-      } else {
-        return Json::Value(Json::nullValue);
-      }
-    } else {
+    const PathSegment& segment = paths[i];
+    const Json::Value* child = pointer->find(segment.data, segment.data + segment.length);
+    if (child == nullptr) {
+      return Json::Value(Json::nullValue);
+    }
+    pointer = child->find("files", "files" + 5);
+    if (pointer == nullptr) {
       return Json::Value(Json::nullValue);
     }
   }
 
-  std::string basename = paths[paths.size() - 1];
-  if (pointer->isMember(basename)) {
-    return pointer->operator[](basename);
+  const PathSegment& basename = paths[paths.size() - 1];
+  const Json::Value* node = pointer->find(basename.data, basename.data + basename.length);
+  if (node != nullptr) {
+    return *node;
   }
   
   return Json::Value(Json::nullValue);
 }
 
+Json::Value* AsarFileSystem::findNode(const std::string& path) {
+  if (path == "") return nullptr;
+  PathSegments paths(path);
+  if (paths.empty()) return &this->header;
+
+  Json::Value* pointer = &(this->header["files"]);
+  for (size_t i = 0; i < paths.size(); i++) {
+    const PathSegment& segment = paths[i];
+    Json::Value* child = const_cast<Json::Value*>(pointer->find(segment.data, segment.data + segment.length));
+    if (child == nullptr || i == paths.size() - 1) {
+      return child;
+    }
+    pointer = const_cast<Json::Value*>(child->find("files", "files" + 5));
+    if (pointer == nullptr) {
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
 std::string AsarFileSystem::toJson(bool format) const {
   Json::StreamWriterBuilder wb;
   wb.settings_["emitUTF8"] = true;
@@ -0,0 +1,590 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "asar/AsarIndex.hpp"
+#include "asar/AsarError.hpp"
+
+namespace asar {
+
+// Single-pass parser for the asar header schema. Instead of building a JSON
+// DOM it writes index entries straight from the raw header bytes, staging
+// them in document order and laying them out breadth-first at the end.
+// Given a lazy source it parses one directory level at a time and leaves
+// nested "files" objects as byte ranges to be expanded later.
+class AsarHeaderParser {
+ public:
+  AsarHeaderParser(AsarIndex& index, const char* data, size_t length, const AsarIndex::LazySource* lazy = nullptr):
+    _index(index), _lazy(lazy), _begin(data), _p(data), _end(data + length), _staged(), _dead() {}
+
+  // Structural pre-scan: pairs up the braces of every object outside strings.
+  static void scan(AsarIndex::LazySource& source) {
+    const char* data = source.json;
+    size_t length = source.length;
+    std::vector<uint32_t> stack;
+    source.opens.clear();
+    source.closes.clear();
+    source.opens.reserve(length / 64);
+    source.closes.reserve(length / 64);
+    for (size_t i = 0; i < length; i++) {
+      char c = data[i];
+      if (c == '"') {
+        while (true) {
+          const char* quote = static_cast<const char*>(memchr(data + i + 1, '"', length - i - 1));
+          if (quote == nullptr) throw AsarError(invalid_header, "Invalid header: unterminated string.");
+          i = quote - data;
+          // A quote preceded by an odd number of backslashes is escaped.
+          size_t slashes = 0;
+          while (data[i - 1 - slashes] == '\\') slashes++;
+          if (slashes % 2 == 0) break;
+        }
+      } else if (c == '{') {
+        stack.push_back(static_cast<uint32_t>(source.opens.size()));
+        source.opens.push_back(static_cast<uint32_t>(i));
+        source.closes.push_back(0);
+      } else if (c == '}') {
+        if (stack.empty()) throw AsarError(invalid_header, "Invalid header: unbalanced braces.");
+        source.closes[stack.back()] = static_cast<uint32_t>(i);
+        stack.pop_back();
+      }
+    }
+    if (!stack.empty()) throw AsarError(invalid_header, "Invalid header: unbalanced braces.");
+  }
+
+  void parse() {
+    AsarIndex::Entry root;
+    memset(&root, 0, sizeof(AsarIndex::Entry));
+    root.name = this->_index._addString("", 0);
+    root.parent = AsarIndex::npos;
+    root.flags = AsarIndex::FLAG_DIRECTORY;
+    this->_staged.push_back(root);
+
+    this->_expect('{');
+    this->_skipSpace();
+    if (!this->_key("files")) this->_fail("expected \"files\"");
+    this->_expect(':');
+    if (this->_lazy) {
+      this->_deferFiles(0);
+    } else {
+      this->_parseFiles(0, 0);
+    }
+    this->_expect('}');
+    this->_skipSpace();
+    if (this->_p != this->_end && *this->_p != '\0') this->_fail("unexpected trailing data");
+
+    if (this->_lazy) {
+      this->_index._nodes.push_back(this->_staged[0]);
+    } else {
+      this->_layout();
+    }
+  }
+
+  // Parses the deferred "files" object of an unloaded directory and appends its children.
+  void expand(uint32_t dir) {
+    AsarIndex::Entry& entry = this->_index._nodes[dir];
+    this->_p = this->_begin + entry.offset;
+    this->_end = this->_begin + entry.size + 1;
+    this->_parseFiles(dir, 0);
+    this->_append(dir);
+  }
+
+ private:
+  static const int MAX_DEPTH = 1000;
+
+  AsarIndex& _index;
+  const AsarIndex::LazySource* _lazy;
+  const char* _begin;
+  const char* _p;
+  const char* _end;
+  std::vector<AsarIndex::Entry> _staged;
+  std::vector<bool> _dead;
+
+  void _fail(const char* message) const {
+    throw AsarError(invalid_header, std::string("Invalid header: ") + message + " at offset " + std::to_string(this->_p - this->_begin));
+  }
+
+  void _skipSpace() {
+    while (this->_p < this->_end && (*this->_p == ' ' || *this->_p == '\n' || *this->_p == '\r' || *this->_p == '\t')) this->_p++;
+  }
+
+  bool _peek(char c) {
+    this->_skipSpace();
+    return this->_p < this->_end && *this->_p == c;
+  }
+
+  void _expect(char c) {
+    if (!this->_peek(c)) {
+      char message[] = "expected ' '";
+      message[10] = c;
+      this->_fail(message);
+    }
+    this->_p++;
+  }
+
+  // Matches a key without escapes, which is all the schema keys need.
+  bool _key(const char* key) {
+    size_t length = strlen(key);
+    if (this->_end - this->_p < (ptrdiff_t)length + 2 || this->_p[0] != '"' ||
+        memcmp(this->_p + 1, key, length) != 0 || this->_p[length + 1] != '"') {
+      return false;
+    }
+    this->_p += length + 2;
+    return true;
+  }
+
+  static void _appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+      out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+      out += static_cast<char>(0xC0 | (cp >> 6));
+      out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+      out += static_cast<char>(0xE0 | (cp >> 12));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (cp >> 18));
+      out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+  }
+
+  uint32_t _hex4() {
+    if (this->_end - this->_p < 4) this->_fail("bad unicode escape");
+    uint32_t cp = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = *this->_p++;
+      cp <<= 4;
+      if (c >= '0' && c <= '9') cp |= c - '0';
+      else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+      else this->_fail("bad unicode escape");
+    }
+    return cp;
+  }
+
+  // Returns a pointer to the unescaped string, either into the input or into scratch.
+  const char* _string(std::string& scratch, size_t* length) {
+    this->_expect('"');
+    const char* start = this->_p;
+    while (this->_p < this->_end && *this->_p != '"' && *this->_p != '\\') this->_p++;
+    if (this->_p >= this->_end) this->_fail("unterminated string");
+    if (*this->_p == '"') {
+      *length = this->_p - start;
+      this->_p++;
+      return start;
+    }
+
+    scratch.assign(start, this->_p);
+    while (true) {
+      if (this->_p >= this->_end) this->_fail("unterminated string");
+      char c = *this->_p++;
+      if (c == '"') break;
+      if (c != '\\') {
+        scratch += c;
+        continue;
+      }
+      if (this->_p >= this->_end) this->_fail("unterminated string");
+      char e = *this->_p++;
+      switch (e) {
+        case '"': scratch += '"'; break;
+        case '\\': scratch += '\\'; break;
+        case '/': scratch += '/'; break;
+        case 'b': scratch += '\b'; break;
+        case 'f': scratch += '\f'; break;
+        case 'n': scratch += '\n'; break;
+        case 'r': scratch += '\r'; break;
+        case 't': scratch += '\t'; break;
+        case 'u': {
+          uint32_t cp = this->_hex4();
+          if (cp >= 0xD800 && cp <= 0xDBFF) {
+            if (this->_end - this->_p < 6 || this->_p[0] != '\\' || this->_p[1] != 'u') this->_fail("bad surrogate pair");
+            this->_p += 2;
+            uint32_t low = this->_hex4();
+            if (low < 0xDC00 || low > 0xDFFF) this->_fail("bad surrogate pair");
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          }
+          _appendUtf8(scratch, cp);
+          break;
+        }
+        default: this->_fail("bad escape");
+      }
+    }
+    *length = scratch.size();
+    return scratch.data();
+  }
+
+  uint64_t _unsigned(const char* start, const char* end) {
+    if (start == end) this->_fail("expected digits");
+    uint64_t value = 0;
+    for (const char* c = start; c < end; c++) {
+      if (*c < '0' || *c > '9') this->_fail("expected digits");
+      uint64_t next = value * 10 + (*c - '0');
+      if (next / 10 != value) this->_fail("number out of range");
+      value = next;
+    }
+    return value;
+  }
+
+  // Skips any JSON value without interpreting it.
+  void _skipValue(int depth) {
+    if (depth > MAX_DEPTH) this->_fail("nesting too deep");
+    this->_skipSpace();
+    if (this->_p >= this->_end) this->_fail("unexpected end");
+    char c = *this->_p;
+    if (c == '"') {
+      this->_p++;
+      while (this->_p < this->_end && *this->_p != '"') {
+        if (*this->_p == '\\') this->_p++;
+        this->_p++;
+      }
+      if (this->_p >= this->_end) this->_fail("unterminated string");
+      this->_p++;
+    } else if (c == '{' && this->_lazy) {
+      this->_p = this->_begin + this->_matching() + 1;
+    } else if (c == '{' || c == '[') {
+      char close = c == '{' ? '}' : ']';
+      this->_p++;
+      if (this->_peek(close)) {
+        this->_p++;
+        return;
+      }
+      while (true) {
+        if (c == '{') {
+          this->_skipValue(depth + 1);
+          this->_expect(':');
+        }
+        this->_skipValue(depth + 1);
+        if (this->_peek(',')) {
+          this->_p++;
+          continue;
+        }
+        this->_expect(close);
+        break;
+      }
+    } else {
+      while (this->_p < this->_end && *this->_p != ',' && *this->_p != '}' && *this->_p != ']' &&
+             *this->_p != ' ' && *this->_p != '\n' && *this->_p != '\r' && *this->_p != '\t') {
+        this->_p++;
+      }
+    }
+  }
+
+  // Offset of the brace closing the object that starts at the current position.
+  uint32_t _matching() const {
+    uint32_t open = static_cast<uint32_t>(this->_p - this->_begin);
+    auto it = std::lower_bound(this->_lazy->opens.begin(), this->_lazy->opens.end(), open);
+    if (it == this->_lazy->opens.end() || *it != open) this->_fail("expected '{'");
+    return this->_lazy->closes[it - this->_lazy->opens.begin()];
+  }
+
+  // Records the byte range of a "files" object instead of parsing it.
+  void _deferFiles(uint32_t id) {
+    if (!this->_peek('{')) this->_fail("expected '{'");
+    AsarIndex::Entry& entry = this->_staged[id];
+    entry.flags |= AsarIndex::FLAG_DIRECTORY | AsarIndex::FLAG_UNLOADED;
+    entry.offset = static_cast<uint64_t>(this->_p - this->_begin);
+    entry.size = this->_matching();
+    this->_p = this->_begin + entry.size + 1;
+  }
+
+  bool _bool() {
+    this->_skipSpace();
+    if (this->_end - this->_p >= 4 && memcmp(this->_p, "true", 4) == 0) {
+      this->_p += 4;
+      return true;
+    }
+    if (this->_end - this->_p >= 5 && memcmp(this->_p, "false", 5) == 0) {
+      this->_p += 5;
+      return false;
+    }
+    if (this->_end - this->_p >= 4 && memcmp(this->_p, "null", 4) == 0) {
+      this->_p += 4;
+      return false;
+    }
+    this->_fail("expected boolean");
+    return false;
+  }
+
+  // Parses the members of a "files" object, staging one entry per member.
+  void _parseFiles(uint32_t parent, int depth) {
+    if (depth > MAX_DEPTH) this->_fail("nesting too deep");
+    this->_expect('{');
+    if (this->_peek('}')) {
+      this->_p++;
+      return;
+    }
+    std::string scratch;
+    while (true) {
+      size_t length = 0;
+      const char* name = this->_string(scratch, &length);
+
+      AsarIndex::Entry entry;
+      memset(&entry, 0, sizeof(AsarIndex::Entry));
+      entry.name = this->_index._addString(name, length);
+      entry.nameLength = static_cast<uint32_t>(length);
+      entry.parent = parent;
+      uint32_t id = static_cast<uint32_t>(this->_staged.size());
+      this->_staged.push_back(entry);
+
+      this->_expect(':');
+      this->_parseNode(id, depth + 1);
+
+      if (this->_peek(',')) {
+        this->_p++;
+        continue;
+      }
+      this->_expect('}');
+      break;
+    }
+  }
+
+  void _parseNode(uint32_t id, int depth) {
+    this->_expect('{');
+    if (this->_peek('}')) {
+      this->_p++;
+      return;
+    }
+    std::string extra;
+    std::string scratch;
+    while (true) {
+      this->_skipSpace();
+      const char* keyStart = this->_p;
+      if (this->_key("files")) {
+        this->_expect(':');
+        if (this->_lazy) {
+          this->_deferFiles(id);
+        } else {
+          this->_staged[id].flags |= AsarIndex::FLAG_DIRECTORY;
+          this->_parseFiles(id, depth);
+        }
+      } else if (this->_key("size")) {
+        this->_expect(':');
+        this->_skipSpace();
+        const char* start = this->_p;
+        while (this->_p < this->_end && *this->_p >= '0' && *this->_p <= '9') this->_p++;
+        this->_staged[id].size = this->_unsigned(start, this->_p);
+        this->_staged[id].flags |= AsarIndex::FLAG_HAS_SIZE;
+      } else if (this->_key("offset")) {
+        this->_expect(':');
+        this->_skipSpace();
+        bool quoted = this->_p < this->_end && *this->_p == '"';
+        if (quoted) this->_p++;
+        const char* start = this->_p;
+        while (this->_p < this->_end && *this->_p >= '0' && *this->_p <= '9') this->_p++;
+        this->_staged[id].offset = this->_unsigned(start, this->_p);
+        this->_staged[id].flags |= AsarIndex::FLAG_HAS_OFFSET;
+        if (quoted) {
+          if (this->_p >= this->_end || *this->_p != '"') this->_fail("bad \"offset\"");
+          this->_p++;
+        }
+      } else if (this->_key("unpacked")) {
+        this->_expect(':');
+        if (this->_bool()) this->_staged[id].flags |= AsarIndex::FLAG_UNPACKED;
+      } else if (this->_key("executable")) {
+        this->_expect(':');
+        if (this->_bool()) this->_staged[id].flags |= AsarIndex::FLAG_EXECUTABLE;
+      } else if (this->_key("link")) {
+        this->_expect(':');
+        size_t length = 0;
+        const char* link = this->_string(scratch, &length);
+        this->_staged[id].flags |= AsarIndex::FLAG_LINK;
+        this->_staged[id].first = this->_index._addString(link, length);
+        this->_staged[id].count = static_cast<uint32_t>(length);
+      } else {
+        // Anything else (e.g. "integrity") is kept verbatim.
+        this->_skipValue(depth);
+        const char* keyEnd = this->_p;
+        this->_expect(':');
+        const char* valueStart = this->_p;
+        this->_skipValue(depth);
+        extra += extra.empty() ? "{" : ",";
+        extra.append(keyStart, keyEnd);
+        extra += ':';
+        extra.append(valueStart, this->_p);
+      }
+
+      if (this->_peek(',')) {
+        this->_p++;
+        continue;
+      }
+      this->_expect('}');
+      break;
+    }
+
+    AsarIndex::Entry& entry = this->_staged[id];
+    if (!extra.empty()) {
+      extra += '}';
+      entry.extra = this->_index._addString(extra.c_str(), extra.size());
+      entry.extraLength = static_cast<uint32_t>(extra.size());
+    }
+    // A directory keeps only its unpacked flag, which upstream --unpack-dir sets.
+    if (entry.flags & AsarIndex::FLAG_UNLOADED) {
+      entry.flags = AsarIndex::FLAG_DIRECTORY | AsarIndex::FLAG_UNLOADED | (entry.flags & AsarIndex::FLAG_UNPACKED);
+    } else if (entry.flags & AsarIndex::FLAG_DIRECTORY) {
+      entry.flags = AsarIndex::FLAG_DIRECTORY | (entry.flags & AsarIndex::FLAG_UNPACKED);
+      entry.size = 0;
+      entry.offset = 0;
+    } else if (entry.flags & AsarIndex::FLAG_HAS_OFFSET) {
+      this->_resolveOffset(entry);
+    }
+  }
+
+  // Turns a header offset into an absolute archive position, once, so reads never parse it again.
+  void _resolveOffset(AsarIndex::Entry& entry) const {
+    uint64_t base = this->_index._dataOffset;
+    uint64_t limit = this->_index._fileSize;
+    if (entry.offset > UINT64_MAX - base) this->_fail("offset out of range");
+    entry.offset += base;
+    if (entry.flags & (AsarIndex::FLAG_UNPACKED | AsarIndex::FLAG_LINK)) return;
+    if (entry.offset > limit || entry.size > limit - entry.offset) {
+      throw AsarError(invalid_asar, "Invalid asar file. File data out of bounds: offset " +
+        std::to_string(entry.offset - base) + ", size " + std::to_string(entry.size) + ".");
+    }
+  }
+
+  bool _less(const AsarIndex::Entry& a, const AsarIndex::Entry& b) const {
+    const char* pool = this->_index._pool.data();
+    int cmp = memcmp(pool + a.name, pool + b.name, std::min(a.nameLength, b.nameLength));
+    return cmp != 0 ? cmp < 0 : a.nameLength < b.nameLength;
+  }
+
+  // Sorts the staged children of one directory and appends them to the index.
+  void _append(uint32_t dir) {
+    std::vector<uint32_t> order(this->_staged.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = static_cast<uint32_t>(i);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+      return this->_less(this->_staged[a], this->_staged[b]);
+    });
+
+    // Node storage was reserved up front so that entries never move while other threads read them.
+    std::vector<AsarIndex::Entry>& nodes = this->_index._nodes;
+    if (nodes.size() + order.size() > nodes.capacity()) this->_fail("more entries than objects");
+
+    uint32_t first = static_cast<uint32_t>(nodes.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      if (i + 1 < order.size() && !this->_less(this->_staged[order[i]], this->_staged[order[i + 1]])) continue;
+      nodes.push_back(this->_staged[order[i]]);
+    }
+    // Only the child range changes: other threads may be reading the rest of the entry.
+    nodes[dir].first = first;
+    nodes[dir].count = static_cast<uint32_t>(nodes.size()) - first;
+  }
+
+  // Groups staged entries by parent, sorts each group by name and emits the
+  // final breadth-first node array.
+  void _layout() {
+    size_t n = this->_staged.size();
+    std::vector<uint32_t> start(n + 1, 0);
+    for (size_t i = 1; i < n; i++) start[this->_staged[i].parent + 1]++;
+    for (size_t i = 0; i < n; i++) start[i + 1] += start[i];
+
+    std::vector<uint32_t> order(n > 0 ? n - 1 : 0);
+    std::vector<uint32_t> cursor(start.begin(), start.end() - 1);
+    for (size_t i = 1; i < n; i++) order[cursor[this->_staged[i].parent]++] = static_cast<uint32_t>(i);
+
+    this->_dead.assign(n, false);
+    for (size_t d = 0; d < n; d++) {
+      if (start[d + 1] - start[d] < 2) continue;
+      auto first = order.begin() + start[d];
+      auto last = order.begin() + start[d + 1];
+      std::stable_sort(first, last, [this](uint32_t a, uint32_t b) {
+        return this->_less(this->_staged[a], this->_staged[b]);
+      });
+      // Duplicate keys: the last occurrence wins, as with jsoncpp.
+      for (auto it = first; it + 1 < last; ++it) {
+        if (!this->_less(this->_staged[*it], this->_staged[*(it + 1)])) this->_dead[*it] = true;
+      }
+    }
+
+    std::vector<AsarIndex::Entry>& nodes = this->_index._nodes;
+    nodes.clear();
+    nodes.reserve(n);
+    std::vector<uint32_t> source;
+    source.reserve(n);
+    nodes.push_back(this->_staged[0]);
+    source.push_back(0);
+    for (size_t k = 0; k < source.size(); k++) {
+      uint32_t old = source[k];
+      if (!(nodes[k].flags & AsarIndex::FLAG_DIRECTORY)) continue;
+      uint32_t first = static_cast<uint32_t>(nodes.size());
+      for (uint32_t j = start[old]; j < start[old + 1]; j++) {
+        uint32_t child = order[j];
+        if (this->_dead[child]) continue;
+        AsarIndex::Entry entry = this->_staged[child];
+        entry.parent = static_cast<uint32_t>(k);
+        nodes.push_back(entry);
+        source.push_back(child);
+      }
+      nodes[k].first = first;
+      nodes[k].count = static_cast<uint32_t>(nodes.size()) - first;
+    }
+  }
+};
+
+AsarIndex AsarIndex::parseLazy(std::vector<char>&& buffer, size_t begin, size_t length, uint64_t dataOffset, uint64_t fileSize) {
+  std::shared_ptr<LazySource> source = std::make_shared<LazySource>();
+  source->buffer = std::move(buffer);
+  source->json = source->buffer.data() + begin;
+  source->length = length;
+  AsarHeaderParser::scan(*source);
+
+  AsarIndex index;
+  index._nodes.clear();
+  index._pool.clear();
+  index._dataOffset = dataOffset;
+  index._fileSize = fileSize;
+  // Every entry is an object, so the object count bounds the node count, and
+  // the pool never outgrows the header text it is copied from.
+  index._nodes.reserve(source->opens.size() + 1);
+  index._pool.reserve(length + 1);
+  AsarHeaderParser parser(index, source->json, source->length, source.get());
+  parser.parse();
+  source->capacity = index._nodes.capacity();
+  source->loaded.reset(new std::atomic<bool>[source->capacity]);
+  for (size_t i = 0; i < source->capacity; i++) {
+    source->loaded[i].store(i < index._nodes.size() && !(index._nodes[i].flags & FLAG_UNLOADED), std::memory_order_relaxed);
+  }
+  source->count.store(index._nodes.size(), std::memory_order_release);
+  index._lazy = source;
+  return index;
+}
+
+void AsarIndex::_load(uint32_t id) const {
+  LazySource& lazy = *this->_lazy;
+  std::lock_guard<std::mutex> lock(lazy.mutex);
+  if (lazy.loaded[id].load(std::memory_order_relaxed)) return;
+
+  size_t before = this->_nodes.size();
+  const Entry* nodes = this->_nodes.data();
+  const char* pool = this->_pool.data();
+  AsarHeaderParser parser(const_cast<AsarIndex&>(*this), lazy.json, lazy.length, &lazy);
+  parser.expand(id);
+  // Readers hold references into both arrays without the lock, so neither may move.
+  assert(this->_nodes.data() == nodes && this->_nodes.capacity() == lazy.capacity);
+  assert(this->_pool.data() == pool);
+  (void) nodes;
+  (void) pool;
+
+  for (size_t i = before; i < this->_nodes.size(); i++) {
+    lazy.loaded[i].store(!(this->_nodes[i].flags & FLAG_UNLOADED), std::memory_order_release);
+  }
+  lazy.count.store(this->_nodes.size(), std::memory_order_release);
+  lazy.loaded[id].store(true, std::memory_order_release);
+}
+
+AsarIndex AsarIndex::parse(const char* json, size_t length, uint64_t dataOffset, uint64_t fileSize) {
+  AsarIndex index;
+  index._nodes.clear();
+  index._pool.clear();
+  index._dataOffset = dataOffset;
+  index._fileSize = fileSize;
+  AsarHeaderParser parser(index, json, length);
+  parser.parse();
+  return index;
+}
+
+}
@@ -0,0 +1,416 @@
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "AsarIO.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include "toyo/charset.hpp"
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace asar {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(): _data(nullptr), _size(0), _base(nullptr), _file(INVALID_HANDLE_VALUE), _mapping(nullptr) {}
+
+bool MappedFile::open(const std::string& path, uint64_t offset, uint64_t length) {
+  this->close();
+  HANDLE file = ::CreateFileW(toyo::charset::a2w(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) <= offset) {
+    ::CloseHandle(file);
+    return false;
+  }
+  uint64_t available = static_cast<uint64_t>(size.QuadPart) - offset;
+  if (length == 0 || length > available) length = available;
+  HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    ::CloseHandle(file);
+    return false;
+  }
+  // Views start on an allocation granularity boundary.
+  SYSTEM_INFO info;
+  ::GetSystemInfo(&info);
+  uint64_t start = offset / info.dwAllocationGranularity * info.dwAllocationGranularity;
+  void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start & 0xFFFFFFFF),
+    static_cast<SIZE_T>(offset - start + length));
+  if (data == nullptr) {
+    ::CloseHandle(mapping);
+    ::CloseHandle(file);
+    return false;
+  }
+  this->_file = file;
+  this->_mapping = mapping;
+  this->_base = data;
+  this->_data = static_cast<const uint8_t*>(data) + (offset - start);
+  this->_size = length;
+  return true;
+}
+
+void MappedFile::close() {
+  if (this->_base != nullptr) ::UnmapViewOfFile(this->_base);
+  if (this->_mapping != nullptr) ::CloseHandle(this->_mapping);
+  if (this->_file != INVALID_HANDLE_VALUE) ::CloseHandle(this->_file);
+  this->_data = nullptr;
+  this->_size = 0;
+  this->_base = nullptr;
+  this->_mapping = nullptr;
+  this->_file = INVALID_HANDLE_VALUE;
+}
+
+RandomAccessFile::RandomAccessFile(): _handle(INVALID_HANDLE_VALUE) {}
+
+bool RandomAccessFile::open(const std::string& path) {
+  this->close();
+  this->_handle = ::CreateFileW(toyo::charset::a2w(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  return this->_handle != INVALID_HANDLE_VALUE;
+}
+
+void RandomAccessFile::close() {
+  if (this->_handle != INVALID_HANDLE_VALUE) ::CloseHandle(this->_handle);
+  this->_handle = INVALID_HANDLE_VALUE;
+}
+
+bool RandomAccessFile::isOpen() const {
+  return this->_handle != INVALID_HANDLE_VALUE;
+}
+
+size_t RandomAccessFile::readAt(void* buffer, size_t length, uint64_t offset) const {
+  size_t total = 0;
+  while (total < length) {
+    // An explicit offset makes ReadFile positional even on a synchronous handle.
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    uint64_t position = offset + total;
+    overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    size_t remaining = length - total;
+    DWORD chunk = remaining > 0x40000000 ? 0x40000000 : static_cast<DWORD>(remaining);
+    DWORD read = 0;
+    if (!::ReadFile(this->_handle, static_cast<char*>(buffer) + total, chunk, &read, &overlapped) || read == 0) break;
+    total += read;
+  }
+  return total;
+}
+
+void MappedFile::advise(uint64_t, uint64_t, Advice) const {}
+
+void RandomAccessFile::advise(uint64_t, uint64_t, Advice) const {}
+
+bool RandomAccessFile::stat(uint64_t* size, int64_t* mtime) const {
+  LARGE_INTEGER length;
+  FILETIME written;
+  if (!::GetFileSizeEx(this->_handle, &length) || !::GetFileTime(this->_handle, nullptr, nullptr, &written)) return false;
+  *size = static_cast<uint64_t>(length.QuadPart);
+  *mtime = static_cast<int64_t>((static_cast<uint64_t>(written.dwHighDateTime) << 32) | written.dwLowDateTime);
+  return true;
+}
+
+OutputFile::OutputFile(): _handle(INVALID_HANDLE_VALUE) {}
+
+bool OutputFile::open(const std::string& path) {
+  this->close();
+  this->_handle = ::CreateFileW(toyo::charset::a2w(path).c_str(), GENERIC_WRITE, 0,
+    nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  return this->_handle != INVALID_HANDLE_VALUE;
+}
+
+void OutputFile::close() {
+  if (this->_handle != INVALID_HANDLE_VALUE) ::CloseHandle(this->_handle);
+  this->_handle = INVALID_HANDLE_VALUE;
+}
+
+bool OutputFile::isOpen() const {
+  return this->_handle != INVALID_HANDLE_VALUE;
+}
+
+// WriteFileGather needs unbuffered, page-sized writes, so buffers go one by one.
+bool OutputFile::write(const Buffer* buffers, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const char* data = static_cast<const char*>(buffers[i].data);
+    size_t remaining = buffers[i].length;
+    while (remaining > 0) {
+      DWORD chunk = remaining > 0x40000000 ? 0x40000000 : static_cast<DWORD>(remaining);
+      DWORD written = 0;
+      if (!::WriteFile(this->_handle, data, chunk, &written, nullptr) || written == 0) return false;
+      data += written;
+      remaining -= written;
+    }
+  }
+  return true;
+}
+
+bool statFile(const std::string& path, uint64_t* size, int64_t* mtime) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!::GetFileAttributesExW(toyo::charset::a2w(path).c_str(), GetFileExInfoStandard, &data)) return false;
+  *size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+  *mtime = static_cast<int64_t>((static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime);
+  return true;
+}
+
+bool replaceFile(const std::string& src, const std::string& dest) {
+  return ::MoveFileExW(toyo::charset::a2w(src).c_str(), toyo::charset::a2w(dest).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+#else
+
+MappedFile::MappedFile(): _data(nullptr), _size(0), _base(nullptr), _length(0) {}
+
+bool MappedFile::open(const std::string& path, uint64_t offset, uint64_t length) {
+  this->close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) <= offset) {
+    ::close(fd);
+    return false;
+  }
+  uint64_t available = static_cast<uint64_t>(st.st_size) - offset;
+  if (length == 0 || length > available) length = available;
+  // mmap wants a page-aligned file offset.
+  uint64_t page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+  uint64_t start = offset / page * page;
+  size_t mapped = static_cast<size_t>(offset - start + length);
+  void* data = ::mmap(nullptr, mapped, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(start));
+  ::close(fd);
+  if (data == MAP_FAILED) return false;
+  this->_base = data;
+  this->_length = mapped;
+  this->_data = static_cast<const uint8_t*>(data) + (offset - start);
+  this->_size = length;
+  return true;
+}
+
+void MappedFile::close() {
+  if (this->_base != nullptr) ::munmap(this->_base, this->_length);
+  this->_data = nullptr;
+  this->_size = 0;
+  this->_base = nullptr;
+  this->_length = 0;
+}
+
+RandomAccessFile::RandomAccessFile(): _fd(-1) {}
+
+bool RandomAccessFile::open(const std::string& path) {
+  this->close();
+  this->_fd = ::open(path.c_str(), O_RDONLY);
+  return this->_fd >= 0;
+}
+
+void RandomAccessFile::close() {
+  if (this->_fd >= 0) ::close(this->_fd);
+  this->_fd = -1;
+}
+
+bool RandomAccessFile::isOpen() const {
+  return this->_fd >= 0;
+}
+
+size_t RandomAccessFile::readAt(void* buffer, size_t length, uint64_t offset) const {
+  size_t total = 0;
+  while (total < length) {
+    ssize_t read = ::pread(this->_fd, static_cast<char*>(buffer) + total, length - total, static_cast<off_t>(offset + total));
+    if (read < 0 && errno == EINTR) continue;
+    if (read <= 0) break;
+    total += static_cast<size_t>(read);
+  }
+  return total;
+}
+
+bool RandomAccessFile::stat(uint64_t* size, int64_t* mtime) const {
+  struct stat st;
+  if (::fstat(this->_fd, &st) != 0) return false;
+  *size = static_cast<uint64_t>(st.st_size);
+#if defined(__APPLE__)
+  *mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  *mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+void MappedFile::advise(uint64_t offset, uint64_t length, Advice advice) const {
+  if (this->_data == nullptr || length == 0 || offset >= this->_size) return;
+  if (length > this->_size - offset) length = this->_size - offset;
+  // madvise wants a page-aligned start.
+  uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+  uintptr_t end = reinterpret_cast<uintptr_t>(this->_data + offset + length);
+  uintptr_t begin = reinterpret_cast<uintptr_t>(this->_data + offset) / page * page;
+  int flag = MADV_NORMAL;
+  switch (advice) {
+    case Advice::sequential: flag = MADV_SEQUENTIAL; break;
+    case Advice::random: flag = MADV_RANDOM; break;
+    case Advice::willNeed: flag = MADV_WILLNEED; break;
+    case Advice::dontNeed: flag = MADV_DONTNEED; break;
+    default: break;
+  }
+  ::madvise(reinterpret_cast<void*>(begin), static_cast<size_t>(end - begin), flag);
+}
+
+void RandomAccessFile::advise(uint64_t offset, uint64_t length, Advice advice) const {
+  // posix_fadvise would read a length of 0 as "to the end of the file".
+  if (this->_fd < 0 || length == 0) return;
+#if defined(__APPLE__)
+  // No posix_fadvise; F_RDAHEAD toggles readahead and F_RDADVISE prefetches.
+  if (advice == Advice::sequential || advice == Advice::random || advice == Advice::normal) {
+    ::fcntl(this->_fd, F_RDAHEAD, advice == Advice::random ? 0 : 1);
+  } else if (advice == Advice::willNeed) {
+    struct radvisory ra;
+    ra.ra_offset = static_cast<off_t>(offset);
+    ra.ra_count = length > 0x7FFFFFFF ? 0x7FFFFFFF : static_cast<int>(length);
+    ::fcntl(this->_fd, F_RDADVISE, &ra);
+  }
+#else
+  int flag = POSIX_FADV_NORMAL;
+  switch (advice) {
+    case Advice::sequential: flag = POSIX_FADV_SEQUENTIAL; break;
+    case Advice::random: flag = POSIX_FADV_RANDOM; break;
+    case Advice::willNeed: flag = POSIX_FADV_WILLNEED; break;
+    case Advice::dontNeed: flag = POSIX_FADV_DONTNEED; break;
+    default: break;
+  }
+  ::posix_fadvise(this->_fd, static_cast<off_t>(offset), static_cast<off_t>(length), flag);
+#endif
+}
+
+OutputFile::OutputFile(): _fd(-1) {}
+
+bool OutputFile::open(const std::string& path) {
+  this->close();
+  this->_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  return this->_fd >= 0;
+}
+
+void OutputFile::close() {
+  if (this->_fd >= 0) ::close(this->_fd);
+  this->_fd = -1;
+}
+
+bool OutputFile::isOpen() const {
+  return this->_fd >= 0;
+}
+
+bool OutputFile::write(const Buffer* buffers, size_t count) {
+#ifdef IOV_MAX
+  const size_t batch = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+  const size_t batch = 16;
+#endif
+  struct iovec iov[1024];
+  size_t next = 0;
+  // Bytes of buffers[next] already written by a short writev.
+  size_t done = 0;
+  while (next < count) {
+    size_t n = 0;
+    for (size_t i = next; i < count && n < batch; i++) {
+      size_t skip = i == next ? done : 0;
+      if (buffers[i].length == skip) continue;
+      iov[n].iov_base = const_cast<char*>(static_cast<const char*>(buffers[i].data) + skip);
+      iov[n].iov_len = buffers[i].length - skip;
+      n++;
+    }
+    if (n == 0) return true;
+    ssize_t written = ::writev(this->_fd, iov, static_cast<int>(n));
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+    size_t left = static_cast<size_t>(written);
+    while (next < count && left >= buffers[next].length - done) {
+      left -= buffers[next].length - done;
+      done = 0;
+      next++;
+    }
+    done += left;
+  }
+  return true;
+}
+
+bool statFile(const std::string& path, uint64_t* size, int64_t* mtime) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) return false;
+  *size = static_cast<uint64_t>(st.st_size);
+#if defined(__APPLE__)
+  *mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  *mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+bool replaceFile(const std::string& src, const std::string& dest) {
+  return ::rename(src.c_str(), dest.c_str()) == 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+  this->close();
+}
+
+RandomAccessFile::~RandomAccessFile() {
+  this->close();
+}
+
+OutputFile::~OutputFile() {
+  this->close();
+}
+
+bool OutputFile::write(const void* data, size_t length) {
+  Buffer buffer = { data, length };
+  return this->write(&buffer, 1);
+}
+
+const uint8_t* MappedFile::data() const {
+  return this->_data;
+}
+
+uint64_t MappedFile::size() const {
+  return this->_size;
+}
+
+uint64_t hashBytes(const void* data, size_t length, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  uint64_t h = seed ^ (length * m);
+
+  size_t words = length / 8;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t k;
+    memcpy(&k, p + i * 8, 8);
+    k *= m;
+    k ^= k >> 47;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  p += words * 8;
+  uint64_t tail = 0;
+  for (size_t i = 0; i < (length & 7); i++) tail |= static_cast<uint64_t>(p[i]) << (8 * i);
+  if (length & 7) {
+    h ^= tail;
+    h *= m;
+  }
+
+  h ^= h >> 47;
+  h *= m;
+  h ^= h >> 47;
+  return h;
+}
+
+}
@@ -0,0 +1,116 @@
+#ifndef __ASAR_IO_HPP__
+#define __ASAR_IO_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace asar {
+
+// Page cache hints for a byte range. They are advisory only: failures are
+// ignored, and platforms without an equivalent call do nothing. An empty
+// range is a no-op: whole-file hints pass the file size.
+enum class Advice {
+  normal,
+  sequential,
+  random,
+  willNeed,
+  dontNeed
+};
+
+// Read-only memory mapping of a file, or of length bytes of it at offset
+// (a length of 0 reaching to the end). data() points at offset itself;
+// the mapping starts on the page below it.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::string& path, uint64_t offset = 0, uint64_t length = 0);
+  void close();
+  const uint8_t* data() const;
+  uint64_t size() const;
+  void advise(uint64_t offset, uint64_t length, Advice advice) const;
+
+ private:
+  const uint8_t* _data;
+  uint64_t _size;
+  void* _base;
+#ifdef _WIN32
+  void* _file;
+  void* _mapping;
+#else
+  size_t _length;
+#endif
+};
+
+// File opened for positional reads. readAt never touches a shared file
+// position, so any number of threads may read through one instance.
+class RandomAccessFile {
+ public:
+  RandomAccessFile();
+  ~RandomAccessFile();
+  RandomAccessFile(const RandomAccessFile&) = delete;
+  RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const;
+  // Reads up to length bytes at offset; returns fewer only at end of file or on error.
+  size_t readAt(void* buffer, size_t length, uint64_t offset) const;
+  void advise(uint64_t offset, uint64_t length, Advice advice) const;
+  // Size and modification time of the opened file, with the same units as statFile.
+  bool stat(uint64_t* size, int64_t* mtime) const;
+#ifndef _WIN32
+  int fd() const { return this->_fd; }
+#endif
+
+ private:
+#ifdef _WIN32
+  void* _handle;
+#else
+  int _fd;
+#endif
+};
+
+// File written from the start, replacing whatever was there.
+class OutputFile {
+ public:
+  struct Buffer {
+    const void* data;
+    size_t length;
+  };
+
+  OutputFile();
+  ~OutputFile();
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const;
+  // Appends the buffers in order, gathered into as few writes as the platform allows.
+  bool write(const Buffer* buffers, size_t count);
+  bool write(const void* data, size_t length);
+
+ private:
+#ifdef _WIN32
+  void* _handle;
+#else
+  int _fd;
+#endif
+};
+
+bool statFile(const std::string& path, uint64_t* size, int64_t* mtime);
+
+// Atomically replaces dest with src.
+bool replaceFile(const std::string& src, const std::string& dest);
+
+// Fast non-cryptographic 64-bit hash, used to key caches on file contents.
+uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0);
+
+}
+
+#endif
@@ -0,0 +1,331 @@
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+
+#include "json/json.h"
+#include "asar/AsarIndex.hpp"
+#include "asar/AsarError.hpp"
+#include "AsarPath.hpp"
+#include "AsarIO.hpp"
+
+
+namespace asar {
+
+static_assert(std::is_trivially_copyable<AsarNode>::value, "AsarNode must stay trivially copyable");
+
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// Seed of the second path hash, which chains hashBytes over the segments.
+static const uint64_t CHECK_SEED = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t fnv1a(uint64_t hash, const char* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static bool isModelledMember(const std::string& key) {
+  return key == "files" || key == "size" || key == "offset" || key == "unpacked" || key == "executable" || key == "link";
+}
+
+AsarIndex::AsarIndex(): _nodes(), _pool(), _dataOffset(0), _fileSize(UINT64_MAX), _mappedNodes(nullptr), _mappedCount(0), _mappedPool(nullptr) {
+  Entry root;
+  memset(&root, 0, sizeof(Entry));
+  root.name = this->_addString("", 0);
+  root.parent = npos;
+  root.flags = FLAG_DIRECTORY;
+  this->_nodes.push_back(root);
+}
+
+AsarIndex::AsarIndex(const Json::Value& h): _nodes(), _pool(), _dataOffset(0), _fileSize(UINT64_MAX), _mappedNodes(nullptr), _mappedCount(0), _mappedPool(nullptr) {
+  if (!h.isObject()) throw AsarError(invalid_header, "Invalid header.");
+  auto keys = h.getMemberNames();
+  if (keys.size() != 1 || keys[0] != "files" || !h["files"].isObject()) {
+    throw AsarError(invalid_header, "Invalid header.");
+  }
+
+  Entry root;
+  memset(&root, 0, sizeof(Entry));
+  root.name = this->_addString("", 0);
+  root.parent = npos;
+  root.flags = FLAG_DIRECTORY;
+  this->_nodes.push_back(root);
+
+  // Breadth-first, so that every directory's children end up adjacent.
+  std::vector<const Json::Value*> queue;
+  queue.push_back(&h);
+  for (size_t i = 0; i < queue.size(); i++) {
+    if (!(this->_nodes[i].flags & FLAG_DIRECTORY)) continue;
+    const Json::Value& files = (*queue[i])["files"];
+    auto names = files.getMemberNames();
+    this->_nodes[i].first = static_cast<uint32_t>(this->_nodes.size());
+    this->_nodes[i].count = static_cast<uint32_t>(names.size());
+    for (const std::string& childName : names) {
+      const Json::Value& child = files[childName];
+      if (!child.isObject()) throw AsarError(invalid_header, "Invalid header node: " + childName);
+      Entry entry;
+      memset(&entry, 0, sizeof(Entry));
+      entry.name = this->_addString(childName.c_str(), childName.size());
+      entry.nameLength = static_cast<uint32_t>(childName.size());
+      entry.parent = static_cast<uint32_t>(i);
+      this->_readEntry(entry, child);
+      this->_nodes.push_back(entry);
+      queue.push_back(&child);
+    }
+  }
+}
+
+uint32_t AsarIndex::_addString(const char* str, size_t length) {
+  uint32_t pos = static_cast<uint32_t>(this->_pool.size());
+  this->_pool.insert(this->_pool.end(), str, str + length);
+  this->_pool.push_back('\0');
+  return pos;
+}
+
+void AsarIndex::_readEntry(Entry& entry, const Json::Value& json) {
+  Json::Value extra(Json::objectValue);
+  for (const std::string& key : json.getMemberNames()) {
+    if (!isModelledMember(key)) extra[key] = json[key];
+  }
+  if (extra.size() > 0) {
+    Json::StreamWriterBuilder wb;
+    wb.settings_["emitUTF8"] = true;
+    wb.settings_["indentation"] = "";
+    std::string raw = Json::writeString(wb, extra);
+    entry.extra = this->_addString(raw.c_str(), raw.size());
+    entry.extraLength = static_cast<uint32_t>(raw.size());
+  }
+
+  // Upstream asar marks directories packed with --unpack-dir as unpacked too.
+  if (json.isMember("unpacked") && json["unpacked"].asBool()) entry.flags |= FLAG_UNPACKED;
+
+  if (json.isMember("files")) {
+    if (!json["files"].isObject()) throw AsarError(invalid_header, "Invalid header: \"files\" is not an object.");
+    entry.flags |= FLAG_DIRECTORY;
+    return;
+  }
+
+  if (json.isMember("link")) {
+    if (!json["link"].isString()) throw AsarError(invalid_header, "Invalid header: \"link\" is not a string.");
+    std::string link = json["link"].asString();
+    entry.flags |= FLAG_LINK;
+    entry.first = this->_addString(link.c_str(), link.size());
+    entry.count = static_cast<uint32_t>(link.size());
+  }
+
+  if (json.isMember("size")) {
+    if (!json["size"].isUInt64()) throw AsarError(invalid_header, "Invalid header: bad \"size\".");
+    entry.flags |= FLAG_HAS_SIZE;
+    entry.size = json["size"].asUInt64();
+  }
+
+  if (json.isMember("offset")) {
+    const Json::Value& offset = json["offset"];
+    if (offset.isString()) {
+      std::string str = offset.asString();
+      if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) {
+        throw AsarError(invalid_header, "Invalid header: bad \"offset\".");
+      }
+      entry.offset = std::strtoull(str.c_str(), nullptr, 10);
+    } else if (offset.isUInt64()) {
+      entry.offset = offset.asUInt64();
+    } else {
+      throw AsarError(invalid_header, "Invalid header: bad \"offset\".");
+    }
+    entry.flags |= FLAG_HAS_OFFSET;
+  }
+
+  if (json.isMember("executable") && json["executable"].asBool()) entry.flags |= FLAG_EXECUTABLE;
+}
+
+size_t AsarIndex::size() const {
+  if (this->_mapping) return this->_mappedCount;
+  // Another thread may be appending to _nodes.
+  if (this->_lazy) return this->_lazy->count.load(std::memory_order_acquire);
+  return this->_nodes.size();
+}
+
+const AsarIndex::Entry& AsarIndex::at(uint32_t id) const {
+  if (this->_lazy && !this->_lazy->loaded[id].load(std::memory_order_acquire)) this->_load(id);
+  return this->_node(id);
+}
+
+bool AsarIndex::isLazy() const {
+  return this->_lazy != nullptr;
+}
+
+uint64_t AsarIndex::dataOffset() const {
+  return this->_dataOffset;
+}
+
+const char* AsarIndex::name(uint32_t id) const {
+  return this->_string(this->_node(id).name);
+}
+
+const char* AsarIndex::link(uint32_t id) const {
+  const Entry& entry = this->_node(id);
+  return (entry.flags & FLAG_LINK) ? this->_string(entry.first) : "";
+}
+
+uint32_t AsarIndex::findChild(uint32_t dir, const char* name, size_t length) const {
+  const Entry& parent = this->at(dir);
+  if (!(parent.flags & FLAG_DIRECTORY)) return npos;
+
+  // Children are sorted bytewise, the same order jsoncpp keeps object members in.
+  uint32_t lo = parent.first;
+  uint32_t hi = parent.first + parent.count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    const Entry& entry = this->_node(mid);
+    int cmp = memcmp(this->_string(entry.name), name, std::min<size_t>(entry.nameLength, length));
+    if (cmp == 0) cmp = entry.nameLength < length ? -1 : (entry.nameLength > length ? 1 : 0);
+    if (cmp == 0) return mid;
+    if (cmp < 0) lo = mid + 1; else hi = mid;
+  }
+  return npos;
+}
+
+uint32_t AsarIndex::find(const std::string& path) const {
+  return this->find(path.c_str(), path.size());
+}
+
+uint32_t AsarIndex::find(const char* path, size_t length) const {
+  if (length == 0) return npos;
+  PathSegments segments(path, length);
+  if (segments.empty()) return 0;
+
+  return this->_slots.empty() ? this->_walk(segments) : this->_probe(segments);
+}
+
+uint32_t AsarIndex::_walk(const PathSegments& segments) const {
+  uint32_t current = 0;
+  for (const PathSegment& segment : segments) {
+    current = this->findChild(current, segment.data, segment.length);
+    if (current == npos) return npos;
+  }
+  return current;
+}
+
+uint32_t AsarIndex::_probe(const PathSegments& segments) const {
+  // Hash each segment as "/name" so the key of a node extends its parent's.
+  uint64_t hash = FNV_OFFSET_BASIS;
+  uint64_t check = CHECK_SEED;
+  size_t length = 0;
+  for (const PathSegment& segment : segments) {
+    hash = fnv1a(hash, "/", 1);
+    hash = fnv1a(hash, segment.data, segment.length);
+    check = hashBytes(segment.data, segment.length, check);
+    length += 1 + segment.length;
+  }
+
+  size_t mask = this->_slots.size() - 1;
+  for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask) {
+    const Slot& slot = this->_slots[i];
+    if (slot.id == npos) return npos;
+    if (slot.hash == hash && slot.check == check && slot.length == length) return slot.id;
+  }
+}
+
+void AsarIndex::buildHashTable() {
+  // A lazy index only knows the directories visited so far.
+  if (this->_lazy) return;
+
+  size_t capacity = 16;
+  while (capacity < this->size() * 2) capacity <<= 1;
+
+  Slot empty;
+  empty.id = npos;
+  empty.length = 0;
+  empty.hash = 0;
+  empty.check = 0;
+  std::vector<Slot> slots(capacity, empty);
+
+  // Nodes are stored breadth-first, so a parent's keys are always ready before its children need them.
+  std::vector<Slot> keys(this->size(), empty);
+  keys[0].hash = FNV_OFFSET_BASIS;
+  keys[0].check = CHECK_SEED;
+  for (uint32_t id = 1; id < this->size(); id++) {
+    const Entry& entry = this->_node(id);
+    const Slot& parent = keys[entry.parent];
+    Slot& key = keys[id];
+    key.id = id;
+    key.hash = fnv1a(fnv1a(parent.hash, "/", 1), this->name(id), entry.nameLength);
+    key.check = hashBytes(this->name(id), entry.nameLength, parent.check);
+    key.length = parent.length + 1 + entry.nameLength;
+
+    size_t i = static_cast<size_t>(key.hash) & (capacity - 1);
+    while (slots[i].id != npos) i = (i + 1) & (capacity - 1);
+    slots[i] = key;
+  }
+
+  this->_slots.swap(slots);
+}
+
+bool AsarIndex::hasHashTable() const {
+  return !this->_slots.empty();
+}
+
+bool AsarIndex::exists(const std::string& path) const {
+  return this->find(path) != npos;
+}
+
+std::vector<std::string> AsarIndex::readdir(const std::string& path) const {
+  uint32_t id = this->find(path);
+  if (id == npos) {
+    throw AsarError(invalid_path, "No such directory: " + path);
+  }
+  const Entry& entry = this->at(id);
+  if (!(entry.flags & FLAG_DIRECTORY)) {
+    throw AsarError(invalid_path, "Not a directory: " + path);
+  }
+  std::vector<std::string> res;
+  res.reserve(entry.count);
+  for (uint32_t i = entry.first; i < entry.first + entry.count; i++) {
+    res.push_back(std::string(this->name(i), this->_node(i).nameLength));
+  }
+  return res;
+}
+
+Json::Value AsarIndex::toJsonValue(uint32_t id) const {
+  if (id == npos || id >= this->size()) return Json::Value(Json::nullValue);
+  const Entry& entry = this->at(id);
+  Json::Value node(Json::objectValue);
+
+  if (entry.extraLength > 0) {
+    Json::CharReaderBuilder rb;
+    std::unique_ptr<Json::CharReader> reader(rb.newCharReader());
+    const char* raw = this->_string(entry.extra);
+    reader->parse(raw, raw + entry.extraLength, &node, nullptr);
+  }
+
+  if (entry.flags & FLAG_DIRECTORY) {
+    Json::Value files(Json::objectValue);
+    for (uint32_t i = entry.first; i < entry.first + entry.count; i++) {
+      files[std::string(this->name(i), this->_node(i).nameLength)] = this->toJsonValue(i);
+    }
+    node["files"] = files;
+    if (entry.flags & FLAG_UNPACKED) node["unpacked"] = true;
+    return node;
+  }
+
+  if (entry.flags & FLAG_LINK) node["link"] = std::string(this->link(id), entry.count);
+  if (entry.flags & FLAG_HAS_SIZE) node["size"] = static_cast<Json::UInt64>(entry.size);
+  if (entry.flags & FLAG_HAS_OFFSET) node["offset"] = std::to_string(entry.offset - this->_dataOffset);
+  if (entry.flags & FLAG_UNPACKED) node["unpacked"] = true;
+  if (entry.flags & FLAG_EXECUTABLE) node["executable"] = true;
+  return node;
+}
+
+std::string AsarIndex::toJson(bool format) const {
+  Json::StreamWriterBuilder wb;
+  wb.settings_["emitUTF8"] = true;
+  wb.settings_["indentation"] = format ? "  " : "";
+  return Json::writeString(wb, this->toJsonValue(0));
+}
+
+}
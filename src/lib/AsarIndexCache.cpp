@@ -0,0 +1,159 @@
+#include <cstdio>
+#include <cstring>
+
+#include "asar/AsarIndex.hpp"
+#include "asar/AsarError.hpp"
+#include "AsarIO.hpp"
+#include "oid/oid.hpp"
+
+#ifdef _WIN32
+#include "toyo/charset.hpp"
+#endif
+
+namespace asar {
+
+// On-disk layout of a persisted index: this header, the node array and then
+// the string pool, each 8-byte aligned so the mapping can be used in place.
+struct IndexCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t entrySize;
+  uint32_t reserved;
+  uint64_t archiveSize;
+  int64_t archiveMtime;
+  uint64_t headerHash;
+  uint64_t dataOffset;
+  uint64_t nodeCount;
+  uint64_t nodesOffset;
+  uint64_t poolSize;
+  uint64_t poolOffset;
+};
+
+static const char INDEX_CACHE_MAGIC[8] = { 'A', 'S', 'A', 'R', 'I', 'D', 'X', '\0' };
+// 2: directories keep their unpacked flag.
+static const uint32_t INDEX_CACHE_VERSION = 2;
+static const uint32_t INDEX_CACHE_BYTE_ORDER = 0x01020304;
+
+static uint64_t align8(uint64_t n) {
+  return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+void AsarIndex::save(const std::string& path, const CacheKey& key) const {
+  size_t count = this->size();
+  size_t poolSize = this->_mapping ? 0 : this->_pool.size();
+  if (this->_mapping) {
+    const IndexCacheHeader* mapped = reinterpret_cast<const IndexCacheHeader*>(this->_mapping->data());
+    poolSize = static_cast<size_t>(mapped->poolSize);
+  }
+  // Only a fully loaded index can be persisted. Lazy directories keep FLAG_UNLOADED
+  // even once expanded, so a lazy index is never saved.
+  for (size_t i = 0; i < count; i++) {
+    if (this->_node(static_cast<uint32_t>(i)).flags & FLAG_UNLOADED) {
+      throw AsarError(invalid_header, "Cannot save a partially loaded index.");
+    }
+  }
+
+  IndexCacheHeader header;
+  memset(&header, 0, sizeof(IndexCacheHeader));
+  memcpy(header.magic, INDEX_CACHE_MAGIC, sizeof(header.magic));
+  header.version = INDEX_CACHE_VERSION;
+  header.byteOrder = INDEX_CACHE_BYTE_ORDER;
+  header.entrySize = sizeof(Entry);
+  header.archiveSize = key.archiveSize;
+  header.archiveMtime = key.archiveMtime;
+  header.headerHash = key.headerHash;
+  header.dataOffset = this->_dataOffset;
+  header.nodeCount = count;
+  header.nodesOffset = align8(sizeof(IndexCacheHeader));
+  header.poolSize = poolSize;
+  header.poolOffset = align8(header.nodesOffset + count * sizeof(Entry));
+
+  // Write next to the destination and rename over it, so readers never see a partial file.
+  // An ObjectId carries the process and a counter, so concurrent writers never share the name.
+  std::string tmp = path + ".tmp" + ObjectId().toHexString();
+#ifdef _WIN32
+  FILE* fp = ::_wfopen(toyo::charset::a2w(tmp).c_str(), L"wb");
+#else
+  FILE* fp = ::fopen(tmp.c_str(), "wb");
+#endif
+  if (fp == nullptr) {
+    throw AsarError(file_error, "Open file failed: " + tmp);
+  }
+
+  static const char padding[8] = { 0 };
+  bool ok = ::fwrite(&header, sizeof(IndexCacheHeader), 1, fp) == 1;
+  ok = ok && ::fwrite(padding, 1, header.nodesOffset - sizeof(IndexCacheHeader), fp) == header.nodesOffset - sizeof(IndexCacheHeader);
+  const Entry* nodes = this->_mapping ? this->_mappedNodes : this->_nodes.data();
+  ok = ok && (count == 0 || ::fwrite(nodes, sizeof(Entry), count, fp) == count);
+  uint64_t gap = header.poolOffset - (header.nodesOffset + count * sizeof(Entry));
+  ok = ok && ::fwrite(padding, 1, gap, fp) == gap;
+  ok = ok && (poolSize == 0 || ::fwrite(this->_string(0), 1, poolSize, fp) == poolSize);
+  ok = (::fclose(fp) == 0) && ok;
+
+  if (!ok || !replaceFile(tmp, path)) {
+    ::remove(tmp.c_str());
+    throw AsarError(file_error, "Write index cache failed: " + path);
+  }
+}
+
+bool AsarIndex::load(const std::string& path, const CacheKey& key, uint64_t dataOffset, uint64_t fileSize, AsarIndex* out) {
+  std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+  if (!mapping->open(path) || mapping->size() < sizeof(IndexCacheHeader)) return false;
+
+  const uint8_t* data = mapping->data();
+  uint64_t size = mapping->size();
+  const IndexCacheHeader* header = reinterpret_cast<const IndexCacheHeader*>(data);
+  if (memcmp(header->magic, INDEX_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != INDEX_CACHE_VERSION ||
+      header->byteOrder != INDEX_CACHE_BYTE_ORDER ||
+      header->entrySize != sizeof(Entry)) {
+    return false;
+  }
+  if (header->archiveSize != key.archiveSize || header->archiveMtime != key.archiveMtime ||
+      header->headerHash != key.headerHash || header->dataOffset != dataOffset) {
+    return false;
+  }
+  if (header->nodeCount == 0 || header->nodeCount >= npos ||
+      header->nodesOffset % 8 != 0 || header->nodesOffset > size ||
+      header->nodeCount > (size - header->nodesOffset) / sizeof(Entry) ||
+      header->poolOffset > size || header->poolSize > size - header->poolOffset) {
+    return false;
+  }
+
+  // Check every reference once, so a damaged file is rejected here rather than read out of bounds later.
+  const Entry* nodes = reinterpret_cast<const Entry*>(data + header->nodesOffset);
+  const char* pool = reinterpret_cast<const char*>(data + header->poolOffset);
+  uint64_t count = header->nodeCount;
+  uint64_t poolSize = header->poolSize;
+  if (poolSize == 0 || pool[poolSize - 1] != '\0') return false;
+  for (uint64_t i = 0; i < count; i++) {
+    const Entry& entry = nodes[i];
+    if (entry.flags & FLAG_UNLOADED) return false;
+    if (static_cast<uint64_t>(entry.name) + entry.nameLength >= poolSize) return false;
+    if (entry.extraLength > 0 && static_cast<uint64_t>(entry.extra) + entry.extraLength >= poolSize) return false;
+    if (i == 0 ? entry.parent != npos : entry.parent >= i) return false;
+    if (entry.flags & FLAG_DIRECTORY) {
+      if (entry.count > 0 && (entry.first <= i || static_cast<uint64_t>(entry.first) + entry.count > count)) return false;
+    } else if (entry.flags & FLAG_LINK) {
+      if (static_cast<uint64_t>(entry.first) + entry.count >= poolSize) return false;
+    } else if ((entry.flags & FLAG_HAS_OFFSET) && !(entry.flags & FLAG_UNPACKED)) {
+      if (entry.offset < dataOffset || entry.offset > fileSize || entry.size > fileSize - entry.offset) return false;
+    }
+  }
+  if (!(nodes[0].flags & FLAG_DIRECTORY)) return false;
+
+  AsarIndex index;
+  index._nodes.clear();
+  index._pool.clear();
+  index._dataOffset = dataOffset;
+  index._fileSize = fileSize;
+  index._mappedNodes = nodes;
+  index._mappedCount = static_cast<size_t>(count);
+  index._mappedPool = pool;
+  index._mapping = mapping;
+  *out = index;
+  return true;
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef __ASAR_PATH_HPP__
+#define __ASAR_PATH_HPP__
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace asar {
+
+struct PathSegment {
+  const char* data;
+  size_t length;
+
+  bool equals(const char* str, size_t len) const {
+    return this->length == len && memcmp(this->data, str, len) == 0;
+  }
+};
+
+// Splits a path inside the archive on '/' and '\' and resolves '.', '..' and
+// repeated separators in a single pass. Segments point into the caller's
+// string, and up to INLINE_CAPACITY of them are stored without allocating.
+// '..' never climbs above the archive root.
+class PathSegments {
+ public:
+  static const size_t INLINE_CAPACITY = 64;
+
+  PathSegments(const char* path, size_t length): _size(0), _heap() {
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+      if (i < length && path[i] != '/' && path[i] != '\\') continue;
+      size_t len = i - start;
+      const char* segment = path + start;
+      start = i + 1;
+      if (len == 0 || (len == 1 && segment[0] == '.')) continue;
+      if (len == 2 && segment[0] == '.' && segment[1] == '.') {
+        if (this->_size > 0) this->_size--;
+        continue;
+      }
+      this->_push(segment, len);
+    }
+  }
+
+  explicit PathSegments(const std::string& path): PathSegments(path.c_str(), path.size()) {}
+
+  PathSegments(const PathSegments&) = delete;
+  PathSegments& operator=(const PathSegments&) = delete;
+
+  size_t size() const { return this->_size; }
+  bool empty() const { return this->_size == 0; }
+  const PathSegment& operator[](size_t i) const { return this->_data()[i]; }
+  const PathSegment* begin() const { return this->_data(); }
+  const PathSegment* end() const { return this->_data() + this->_size; }
+
+ private:
+  size_t _size;
+  PathSegment _inline[INLINE_CAPACITY];
+  std::vector<PathSegment> _heap;
+
+  const PathSegment* _data() const {
+    return this->_heap.empty() ? this->_inline : this->_heap.data();
+  }
+
+  void _push(const char* data, size_t length) {
+    PathSegment segment = { data, length };
+    if (this->_heap.empty() && this->_size < INLINE_CAPACITY) {
+      this->_inline[this->_size++] = segment;
+      return;
+    }
+    if (this->_heap.empty()) this->_heap.assign(this->_inline, this->_inline + this->_size);
+    this->_heap.resize(this->_size);
+    this->_heap.push_back(segment);
+    this->_size++;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+#include "asar/AsarStream.hpp"
+#include "asar/AsarError.hpp"
+#include "AsarIO.hpp"
+
+#include <cstring>
+
+namespace asar {
+
+AsarStream::AsarStream(): _file(), _mapping(), _base(0), _size(0), _position(0) {}
+
+AsarStream::AsarStream(std::shared_ptr<RandomAccessFile> file, std::shared_ptr<MappedFile> mapping, uint64_t base, uint64_t size):
+  _file(std::move(file)), _mapping(std::move(mapping)), _base(base), _size(size), _position(0) {}
+
+bool AsarStream::isOpen() const {
+  return this->_file != nullptr || this->_mapping != nullptr;
+}
+
+uint64_t AsarStream::size() const {
+  return this->_size;
+}
+
+uint64_t AsarStream::tell() const {
+  return this->_position;
+}
+
+bool AsarStream::eof() const {
+  return this->_position >= this->_size;
+}
+
+size_t AsarStream::read(void* buffer, size_t length) {
+  if (!this->isOpen()) {
+    throw AsarError(file_error, "Stream is not open.");
+  }
+  uint64_t remaining = this->_size - this->_position;
+  if (length > remaining) length = static_cast<size_t>(remaining);
+  if (length == 0) return 0;
+
+  if (this->_mapping) {
+    memcpy(buffer, this->_mapping->data() + this->_base + this->_position, length);
+  } else if (this->_file->readAt(buffer, length, this->_base + this->_position) != length) {
+    throw AsarError(invalid_asar, "Unexpected end of file.");
+  }
+  this->_position += length;
+  return length;
+}
+
+uint64_t AsarStream::seek(int64_t offset, int whence) {
+  int64_t origin;
+  switch (whence) {
+    case SEEK_SET: origin = 0; break;
+    case SEEK_CUR: origin = static_cast<int64_t>(this->_position); break;
+    case SEEK_END: origin = static_cast<int64_t>(this->_size); break;
+    default: throw AsarError(invalid_path, "Invalid seek origin.");
+  }
+  int64_t target = origin + offset;
+  if (target < 0) target = 0;
+  if (static_cast<uint64_t>(target) > this->_size) target = static_cast<int64_t>(this->_size);
+  this->_position = static_cast<uint64_t>(target);
+  return this->_position;
+}
+
+size_t AsarStream::_next(const uint8_t** data, size_t chunkSize, std::vector<uint8_t>* buffer) {
+  uint64_t remaining = this->_size - this->_position;
+  size_t length = chunkSize < remaining ? chunkSize : static_cast<size_t>(remaining);
+  if (length == 0) return 0;
+
+  if (this->_mapping) {
+    *data = this->_mapping->data() + this->_base + this->_position;
+    this->_position += length;
+    return length;
+  }
+  if (buffer->size() < length) buffer->resize(length);
+  length = this->read(buffer->data(), length);
+  *data = buffer->data();
+  return length;
+}
+
+}
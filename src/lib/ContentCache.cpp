@@ -0,0 +1,82 @@
+#include "ContentCache.hpp"
+
+namespace asar {
+
+ContentCache::ContentCache(uint64_t capacity):
+  _capacity(capacity),
+  _protectedCapacity(capacity / 5 * 4),
+  _bytes(0),
+  _protectedBytes(0),
+  _hits(0),
+  _misses(0),
+  _evictions(0),
+  _probation(),
+  _protected(),
+  _items(),
+  _mutex() {}
+
+bool ContentCache::get(uint32_t key, AsarView* out) {
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  auto found = this->_items.find(key);
+  if (found == this->_items.end()) {
+    this->_misses++;
+    return false;
+  }
+  this->_hits++;
+
+  Segment::iterator item = found->second;
+  if (item->isProtected) {
+    this->_protected.splice(this->_protected.begin(), this->_protected, item);
+  } else {
+    item->isProtected = true;
+    this->_protectedBytes += item->value.size();
+    this->_protected.splice(this->_protected.begin(), this->_probation, item);
+    // Demote the coldest protected entries to make room.
+    while (this->_protectedBytes > this->_protectedCapacity && this->_protected.size() > 1) {
+      Segment::iterator last = std::prev(this->_protected.end());
+      last->isProtected = false;
+      this->_protectedBytes -= last->value.size();
+      this->_probation.splice(this->_probation.begin(), this->_protected, last);
+    }
+  }
+  *out = item->value;
+  return true;
+}
+
+void ContentCache::put(uint32_t key, const AsarView& value) {
+  if (value.size() > this->_capacity / 8) return;
+
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  if (this->_items.find(key) != this->_items.end()) return;
+  Item item = { key, value, false };
+  this->_probation.push_front(item);
+  this->_items[key] = this->_probation.begin();
+  this->_bytes += value.size();
+  this->_evict();
+}
+
+void ContentCache::_evict() {
+  while (this->_bytes > this->_capacity) {
+    Segment& victims = this->_probation.empty() ? this->_protected : this->_probation;
+    const Item& item = victims.back();
+    this->_bytes -= item.value.size();
+    if (item.isProtected) this->_protectedBytes -= item.value.size();
+    this->_items.erase(item.key);
+    victims.pop_back();
+    this->_evictions++;
+  }
+}
+
+asar_cache_stats_t ContentCache::stats() const {
+  std::lock_guard<std::mutex> lock(this->_mutex);
+  asar_cache_stats_t stats;
+  stats.hits = this->_hits;
+  stats.misses = this->_misses;
+  stats.evictions = this->_evictions;
+  stats.bytes = this->_bytes;
+  stats.entries = this->_items.size();
+  stats.capacity = this->_capacity;
+  return stats;
+}
+
+}
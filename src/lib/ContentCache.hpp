@@ -0,0 +1,55 @@
+#ifndef __ASAR_CONTENT_CACHE_HPP__
+#define __ASAR_CONTENT_CACHE_HPP__
+
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "asar/asar.h"
+#include "asar/AsarView.hpp"
+
+namespace asar {
+
+// Byte-budgeted cache of file contents keyed by node id. It is a segmented
+// LRU: new entries go to a probation segment and are promoted to the
+// protected segment (80% of the budget) on their second hit, so a one-off
+// scan over many files cannot flush the entries that are actually hot.
+class ContentCache {
+ public:
+  explicit ContentCache(uint64_t capacity);
+  ContentCache(const ContentCache&) = delete;
+  ContentCache& operator=(const ContentCache&) = delete;
+
+  bool get(uint32_t key, AsarView* out);
+  // Entries larger than an eighth of the budget are not kept.
+  void put(uint32_t key, const AsarView& value);
+  asar_cache_stats_t stats() const;
+
+ private:
+  struct Item {
+    uint32_t key;
+    AsarView value;
+    bool isProtected;
+  };
+  typedef std::list<Item> Segment;
+
+  uint64_t _capacity;
+  uint64_t _protectedCapacity;
+  uint64_t _bytes;
+  uint64_t _protectedBytes;
+  uint64_t _hits;
+  uint64_t _misses;
+  uint64_t _evictions;
+  Segment _probation;
+  Segment _protected;
+  std::unordered_map<uint32_t, Segment::iterator> _items;
+  mutable std::mutex _mutex;
+
+  void _evict();
+};
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "DirectoryScanner.hpp"
+#include "ThreadPool.hpp"
+
+#include "toyo/fs.hpp"
+#include "toyo/path.hpp"
+
+#include <thread>
+
+namespace asar {
+
+DirectoryScanner::DirectoryScanner(size_t threads, const GlobSet* exclude):
+  _workers(),
+  _pending(0),
+  _queued(0),
+  _idleMutex(),
+  _idle(),
+  _failed(false),
+  _error(),
+  _errorMutex() {
+  for (size_t i = 0; i < threads; i++) {
+    this->_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    if (exclude != nullptr && !exclude->empty()) {
+      this->_workers.back()->exclude.reset(new GlobSet(*exclude));
+    }
+  }
+}
+
+ScannedEntry DirectoryScanner::scan(const std::string& dir, size_t threads, const GlobSet* exclude) {
+  if (threads == 0) threads = ThreadPool::defaultSize();
+
+  ScannedEntry root;
+  root.path = dir;
+  root.directory = true;
+  root.symlink = false;
+  root.size = 0;
+  root.mode = 0;
+
+  DirectoryScanner scanner(threads, exclude);
+  scanner._push(0, Task{ &root, "" });
+  // The calling thread is worker 0.
+  std::vector<std::thread> helpers;
+  for (size_t i = 1; i < threads; i++) {
+    helpers.push_back(std::thread(&DirectoryScanner::_run, &scanner, i));
+  }
+  scanner._run(0);
+  for (std::thread& helper : helpers) {
+    helper.join();
+  }
+
+  if (scanner._error) {
+    std::rethrow_exception(scanner._error);
+  }
+  return root;
+}
+
+void DirectoryScanner::_push(size_t self, Task task) {
+  {
+    std::lock_guard<std::mutex> lock(this->_workers[self]->mutex);
+    this->_workers[self]->tasks.push_back(std::move(task));
+    std::lock_guard<std::mutex> idle(this->_idleMutex);
+    this->_pending++;
+    this->_queued++;
+  }
+  this->_idle.notify_one();
+}
+
+bool DirectoryScanner::_take(size_t self, Task* task) {
+  {
+    Worker& own = *this->_workers[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      std::lock_guard<std::mutex> idle(this->_idleMutex);
+      this->_queued--;
+      return true;
+    }
+  }
+  for (size_t i = 1; i < this->_workers.size(); i++) {
+    Worker& victim = *this->_workers[(self + i) % this->_workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      std::lock_guard<std::mutex> idle(this->_idleMutex);
+      this->_queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void DirectoryScanner::_run(size_t self) {
+  for (;;) {
+    Task task;
+    if (!this->_take(self, &task)) {
+      // Both counts change under _idleMutex, so a push or the end of the
+      // last task cannot slip in between the check and the wait.
+      std::unique_lock<std::mutex> lock(this->_idleMutex);
+      this->_idle.wait(lock, [this]() { return this->_queued > 0 || this->_pending == 0; });
+      if (this->_pending == 0) return;
+      continue;
+    }
+    if (!this->_failed) {
+      try {
+        this->_scan(self, task);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(this->_errorMutex);
+        if (!this->_error) this->_error = std::current_exception();
+        this->_failed = true;
+      }
+    }
+    bool done = false;
+    {
+      std::lock_guard<std::mutex> lock(this->_idleMutex);
+      done = --this->_pending == 0;
+    }
+    if (done) {
+      this->_idle.notify_all();
+    }
+  }
+}
+
+void DirectoryScanner::_scan(size_t self, const Task& task) {
+  ScannedEntry* dir = task.dir;
+  const GlobSet* exclude = this->_workers[self]->exclude.get();
+  std::vector<std::string> items = toyo::fs::readdir(dir->path);
+  dir->children.reserve(items.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    if (items[i] == "." || items[i] == "..") continue;
+    if (exclude != nullptr && exclude->match(task.pathInRoot + "/" + items[i]) != 0) continue;
+    ScannedEntry entry;
+    entry.name = items[i];
+    entry.path = toyo::path::join(dir->path, items[i]);
+    toyo::fs::stats stat = toyo::fs::lstat(entry.path);
+    entry.directory = stat.is_directory();
+    entry.symlink = stat.is_symbolic_link();
+    entry.size = static_cast<uint64_t>(stat.size);
+    entry.mode = static_cast<int>(stat.mode);
+    if (entry.symlink) {
+      entry.realpath = toyo::fs::realpath(entry.path);
+    }
+    dir->children.push_back(std::move(entry));
+  }
+  // Only once the children are in place, since other workers write into them.
+  for (ScannedEntry& child : dir->children) {
+    if (child.directory) this->_push(self, Task{ &child, task.pathInRoot + "/" + child.name });
+  }
+}
+
+}
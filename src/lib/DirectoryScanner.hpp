@@ -0,0 +1,79 @@
+#ifndef __ASAR_DIRECTORY_SCANNER_HPP__
+#define __ASAR_DIRECTORY_SCANNER_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "GlobSet.hpp"
+
+namespace asar {
+
+// One entry of a scanned tree, as lstat saw it.
+struct ScannedEntry {
+  std::string name;
+  std::string path;
+  bool directory;
+  bool symlink;
+  uint64_t size;
+  int mode;
+  // Resolved target, for symlinks only.
+  std::string realpath;
+  // In readdir order, for directories only.
+  std::vector<ScannedEntry> children;
+};
+
+// Scans a directory tree on work-stealing threads. A task reads one
+// directory and lstats all of its entries; subdirectories become tasks on
+// the worker's own deque, which it drains newest first, while idle workers
+// steal the oldest tasks of the others. Every entry keeps its readdir
+// position, so the tree is the same whatever the number of threads.
+class DirectoryScanner {
+ public:
+  // Uses one thread per core when threads is 0. Entries whose path below dir
+  // matches exclude are left out without being statted, and excluded
+  // directories are not read at all.
+  static ScannedEntry scan(const std::string& dir, size_t threads = 0, const GlobSet* exclude = nullptr);
+
+ private:
+  struct Task {
+    ScannedEntry* dir;
+    // Relative to the scanned root, with a leading slash (empty for the root).
+    std::string pathInRoot;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    // Matching updates the set's cache, so every worker has its own copy.
+    std::unique_ptr<GlobSet> exclude;
+  };
+
+  DirectoryScanner(size_t threads, const GlobSet* exclude);
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  // Guarded by _idleMutex: directories queued or being scanned, and queued only.
+  size_t _pending;
+  size_t _queued;
+  std::mutex _idleMutex;
+  std::condition_variable _idle;
+  std::atomic<bool> _failed;
+  std::exception_ptr _error;
+  std::mutex _errorMutex;
+
+  void _push(size_t self, Task task);
+  bool _take(size_t self, Task* task);
+  void _run(size_t self);
+  void _scan(size_t self, const Task& task);
+};
+
+}
+
+#endif
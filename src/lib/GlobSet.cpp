@@ -0,0 +1,236 @@
+#include "GlobSet.hpp"
+
+#include <algorithm>
+
+namespace asar {
+
+// Expands the first {a,b,...} group that has a comma, recursively.
+static void expandBraces(const std::string& glob, std::vector<std::string>* out) {
+  int depth = 0;
+  size_t open = std::string::npos;
+  std::vector<size_t> commas;
+  bool inClass = false;
+  for (size_t i = 0; i < glob.size(); i++) {
+    char c = glob[i];
+    if (c == '\\') {
+      i++;
+    } else if (inClass) {
+      if (c == ']') inClass = false;
+    } else if (c == '[') {
+      inClass = true;
+    } else if (c == '{') {
+      if (depth++ == 0) {
+        open = i;
+        commas.clear();
+      }
+    } else if (c == ',' && depth == 1) {
+      commas.push_back(i);
+    } else if (c == '}' && depth > 0 && --depth == 0) {
+      if (commas.empty()) continue;
+      std::string prefix = glob.substr(0, open);
+      std::string suffix = glob.substr(i + 1);
+      size_t begin = open + 1;
+      commas.push_back(i);
+      for (size_t comma : commas) {
+        expandBraces(prefix + glob.substr(begin, comma - begin) + suffix, out);
+        begin = comma + 1;
+      }
+      return;
+    }
+  }
+  out->push_back(glob);
+}
+
+GlobSet::GlobSet(): _base(), _path() {}
+
+void GlobSet::add(const std::string& glob, uint32_t tag) {
+  std::vector<std::string> globs;
+  expandBraces(glob, &globs);
+  for (std::string& item : globs) {
+    size_t start = 0;
+    while (start < item.size() && (item[start] == '/' || item.compare(start, 2, "./") == 0)) {
+      start += item[start] == '/' ? 1 : 2;
+    }
+    item = item.substr(start);
+    if (item.empty()) continue;
+    if (item.find('/') == std::string::npos) {
+      this->_base.compile(item, tag);
+    } else {
+      this->_path.compile(item, tag);
+    }
+  }
+}
+
+bool GlobSet::empty() const {
+  return this->_base.starts.empty() && this->_path.starts.empty();
+}
+
+uint32_t GlobSet::match(const std::string& path) const {
+  size_t begin = path.find_first_not_of('/');
+  if (begin == std::string::npos) return 0;
+  size_t slash = path.rfind('/');
+  size_t name = slash == std::string::npos || slash < begin ? begin : slash + 1;
+  return this->_path.run(path.data() + begin, path.size() - begin) |
+    this->_base.run(path.data() + name, path.size() - name);
+}
+
+size_t GlobSet::Automaton::push(State::Type type, uint8_t byte, size_t set) {
+  State state;
+  state.type = type;
+  state.byte = byte;
+  state.set = set;
+  state.out = this->states.size() + 1;
+  state.tag = 0;
+  this->states.push_back(state);
+  return this->states.size() - 1;
+}
+
+void GlobSet::Automaton::compile(const std::string& glob, uint32_t tag) {
+  // Cached DFA states do not know about the new glob.
+  this->dfaStates.clear();
+  this->dfaTags.clear();
+  this->dfaNext.clear();
+  this->dfaIds.clear();
+
+  if (this->sets.empty()) {
+    std::bitset<256> all;
+    all.set();
+    std::bitset<256> segment = all;
+    segment.reset('/');
+    this->sets.push_back(all);
+    this->sets.push_back(segment);
+  }
+  const size_t ALL = 0;
+  const size_t SEGMENT = 1;
+
+  this->starts.push_back(this->states.size());
+  size_t i = 0;
+  while (i < glob.size()) {
+    char c = glob[i];
+    if (c == '*') {
+      size_t stars = 1;
+      while (i + stars < glob.size() && glob[i + stars] == '*') stars++;
+      bool wholeSegment = (i == 0 || glob[i - 1] == '/') && (i + stars == glob.size() || glob[i + stars] == '/');
+      if (stars >= 2 && wholeSegment && i + stars < glob.size()) {
+        // "**/": nothing, or any run of segments ending in a slash.
+        size_t entry = this->push(State::SPLIT);
+        size_t loop = this->push(State::SET, 0, ALL);
+        size_t slash = this->push(State::BYTE, '/');
+        this->states[entry].epsilon.push_back(loop);
+        this->states[entry].epsilon.push_back(slash + 1);
+        this->states[loop].out = loop;
+        this->states[loop].epsilon.push_back(slash);
+        i += stars + 1;
+      } else {
+        size_t loop = this->push(State::SET, 0, stars >= 2 && wholeSegment ? ALL : SEGMENT);
+        this->states[loop].out = loop;
+        this->states[loop].epsilon.push_back(loop + 1);
+        i += stars;
+      }
+    } else if (c == '?') {
+      this->push(State::SET, 0, SEGMENT);
+      i++;
+    } else if (c == '[') {
+      std::bitset<256> set;
+      size_t j = i + 1;
+      bool negate = j < glob.size() && (glob[j] == '!' || glob[j] == '^');
+      if (negate) j++;
+      bool closed = false;
+      bool first = true;
+      while (j < glob.size()) {
+        if (glob[j] == ']' && !first) {
+          closed = true;
+          break;
+        }
+        first = false;
+        unsigned char low = static_cast<unsigned char>(glob[j] == '\\' && j + 1 < glob.size() ? glob[++j] : glob[j]);
+        unsigned char high = low;
+        if (j + 2 < glob.size() && glob[j + 1] == '-' && glob[j + 2] != ']') {
+          j += 2;
+          high = static_cast<unsigned char>(glob[j] == '\\' && j + 1 < glob.size() ? glob[++j] : glob[j]);
+        }
+        for (unsigned int b = low; b <= high; b++) set.set(b);
+        j++;
+      }
+      if (!closed) {
+        // No closing bracket: a literal '['.
+        this->push(State::BYTE, '[');
+        i++;
+        continue;
+      }
+      if (negate) set.flip();
+      set.reset('/');
+      this->sets.push_back(set);
+      this->push(State::SET, 0, this->sets.size() - 1);
+      i = j + 1;
+    } else {
+      if (c == '\\' && i + 1 < glob.size()) c = glob[++i];
+      this->push(State::BYTE, static_cast<uint8_t>(c));
+      i++;
+    }
+  }
+  size_t accept = this->push(State::ACCEPT);
+  this->states[accept].tag = tag;
+}
+
+void GlobSet::Automaton::closure(std::vector<size_t>* nfaStates) const {
+  std::vector<size_t> stack(*nfaStates);
+  std::vector<bool> seen(this->states.size(), false);
+  nfaStates->clear();
+  while (!stack.empty()) {
+    size_t s = stack.back();
+    stack.pop_back();
+    if (seen[s]) continue;
+    seen[s] = true;
+    nfaStates->push_back(s);
+    for (size_t next : this->states[s].epsilon) stack.push_back(next);
+  }
+  std::sort(nfaStates->begin(), nfaStates->end());
+}
+
+int32_t GlobSet::Automaton::intern(std::vector<size_t> nfaStates) {
+  this->closure(&nfaStates);
+  auto found = this->dfaIds.find(nfaStates);
+  if (found != this->dfaIds.end()) return found->second;
+
+  int32_t id = static_cast<int32_t>(this->dfaStates.size());
+  uint32_t tags = 0;
+  for (size_t s : nfaStates) {
+    if (this->states[s].type == State::ACCEPT) tags |= this->states[s].tag;
+  }
+  this->dfaIds[nfaStates] = id;
+  this->dfaStates.push_back(std::move(nfaStates));
+  this->dfaTags.push_back(tags);
+  this->dfaNext.resize(this->dfaNext.size() + 256, -1);
+  return id;
+}
+
+uint32_t GlobSet::Automaton::run(const char* data, size_t length) {
+  if (this->starts.empty()) return 0;
+  if (this->dfaStates.empty()) {
+    this->intern(std::vector<size_t>());  // 0: dead
+    this->intern(this->starts);           // 1: start
+  }
+
+  int32_t current = 1;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t byte = static_cast<uint8_t>(data[i]);
+    int32_t next = this->dfaNext[static_cast<size_t>(current) * 256 + byte];
+    if (next < 0) {
+      std::vector<size_t> targets;
+      for (size_t s : this->dfaStates[current]) {
+        const State& state = this->states[s];
+        if ((state.type == State::BYTE && state.byte == byte) || (state.type == State::SET && this->sets[state.set][byte])) {
+          targets.push_back(state.out);
+        }
+      }
+      next = this->intern(std::move(targets));
+      this->dfaNext[static_cast<size_t>(current) * 256 + byte] = next;
+    }
+    if (next == 0) return 0;
+    current = next;
+  }
+  return this->dfaTags[current];
+}
+
+}
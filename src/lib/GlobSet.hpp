@@ -0,0 +1,69 @@
+#ifndef __ASAR_GLOB_SET_HPP__
+#define __ASAR_GLOB_SET_HPP__
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace asar {
+
+// Globs compiled together into one automaton, so a path is tested against
+// all of them in a single walk over its bytes. Each glob carries a tag, and
+// match returns the tags of every glob that matches.
+//
+// The syntax follows minimatch, as upstream asar uses it: * and ? stay
+// within a path segment, ** spans segments, [...] and {a,b} are supported,
+// and \ escapes the next character. A glob without a slash matches the last
+// segment of a path at any depth. Paths are relative to the archive root,
+// with forward slashes; a leading slash on either side is ignored.
+//
+// The automaton is an NFA whose DFA states are built on first use and then
+// reused, so matching is a table walk once the set has warmed up. Matching
+// updates that cache, so a set must not be shared between threads.
+class GlobSet {
+ public:
+  GlobSet();
+
+  void add(const std::string& glob, uint32_t tag);
+  bool empty() const;
+  uint32_t match(const std::string& path) const;
+
+ private:
+  struct State {
+    enum Type { BYTE, SET, SPLIT, ACCEPT } type;
+    uint8_t byte;
+    size_t set;
+    size_t out;
+    std::vector<size_t> epsilon;
+    uint32_t tag;
+  };
+
+  // One NFA with its lazily built DFA. Globs without a slash go to the one
+  // run on the last segment, the others to the one run on the whole path.
+  struct Automaton {
+    std::vector<State> states;
+    std::vector<std::bitset<256>> sets;
+    std::vector<size_t> starts;
+    std::vector<std::vector<size_t>> dfaStates;
+    std::vector<uint32_t> dfaTags;
+    // 256 transitions per DFA state, -1 until computed.
+    std::vector<int32_t> dfaNext;
+    std::map<std::vector<size_t>, int32_t> dfaIds;
+
+    void compile(const std::string& glob, uint32_t tag);
+    uint32_t run(const char* data, size_t length);
+    int32_t intern(std::vector<size_t> nfaStates);
+    void closure(std::vector<size_t>* nfaStates) const;
+    size_t push(State::Type type, uint8_t byte = 0, size_t set = 0);
+  };
+
+  mutable Automaton _base;
+  mutable Automaton _path;
+};
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "PackWriter.hpp"
+#include "AsarIO.hpp"
+#include "ThreadPool.hpp"
+#include "asar/AsarError.hpp"
+
+#include <algorithm>
+
+namespace asar {
+
+const uint64_t PackWriter::DEFAULT_MEMORY;
+static const uint64_t MAX_PIECE = 4 * 1024 * 1024;
+// Pieces handed to a single gathered write.
+static const size_t MAX_BATCH = 512;
+
+static const char ZEROS[64 * 1024] = { 0 };
+
+PackWriter::PackWriter(const std::vector<Source>& sources, uint64_t memory):
+  _sources(sources),
+  _pieces(),
+  _memory(memory),
+  _mutex(),
+  _loaded(),
+  _freed(),
+  _nextRead(0),
+  _inFlight(0),
+  _failed(false),
+  _error() {
+  uint64_t pieceSize = std::min(MAX_PIECE, memory);
+  uint64_t written = 0;
+  for (size_t i = 0; i < sources.size(); i++) {
+    const Source& source = sources[i];
+    uint64_t begin = 0;
+    // An empty file still gets a piece for the padding in front of it.
+    do {
+      Piece piece;
+      piece.source = i;
+      piece.begin = begin;
+      piece.length = static_cast<size_t>(std::min(pieceSize, source.size - begin));
+      piece.padding = begin == 0 && source.offset > written ? source.offset - written : 0;
+      piece.data = source.data != nullptr ? source.data + begin : nullptr;
+      piece.ready = source.data != nullptr || piece.length == 0;
+      begin += piece.length;
+      this->_pieces.push_back(std::move(piece));
+    } while (begin < source.size);
+    written = std::max(written, source.offset) + source.size;
+  }
+}
+
+void PackWriter::write(OutputFile* out, const std::vector<Source>& sources, size_t threads, uint64_t memory) {
+  if (threads == 0) threads = ThreadPool::defaultSize();
+  PackWriter writer(sources, memory == 0 ? DEFAULT_MEMORY : memory);
+
+  {
+    // Declared after the writer, so its destructor joins the readers first.
+    ThreadPool readers(threads);
+    for (size_t i = 0; i < threads; i++) {
+      readers.post([&writer]() { writer._read(); });
+    }
+
+    std::vector<OutputFile::Buffer> buffers;
+    size_t next = 0;
+    while (next < writer._pieces.size()) {
+      size_t end = next;
+      {
+        std::unique_lock<std::mutex> lock(writer._mutex);
+        writer._loaded.wait(lock, [&]() { return writer._failed || writer._pieces[next].ready; });
+        if (writer._failed) break;
+        while (end < writer._pieces.size() && end - next < MAX_BATCH && writer._pieces[end].ready) end++;
+      }
+
+      buffers.clear();
+      for (size_t i = next; i < end; i++) {
+        const Piece& piece = writer._pieces[i];
+        for (uint64_t padding = piece.padding; padding > 0;) {
+          size_t chunk = static_cast<size_t>(std::min<uint64_t>(padding, sizeof(ZEROS)));
+          buffers.push_back({ ZEROS, chunk });
+          padding -= chunk;
+        }
+        buffers.push_back({ piece.data, piece.length });
+      }
+      if (!out->write(buffers.data(), buffers.size())) {
+        writer._fail(std::make_exception_ptr(AsarError(file_error, "Write file failed.")));
+        break;
+      }
+
+      uint64_t freed = 0;
+      for (size_t i = next; i < end; i++) {
+        Piece& piece = writer._pieces[i];
+        if (piece.buffer) {
+          freed += piece.length;
+          piece.buffer.reset();
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lock(writer._mutex);
+        writer._inFlight -= freed;
+      }
+      writer._freed.notify_all();
+      next = end;
+    }
+  }
+
+  if (writer._error) {
+    std::rethrow_exception(writer._error);
+  }
+}
+
+void PackWriter::_read() {
+  for (;;) {
+    Piece* piece = nullptr;
+    {
+      // Pieces are taken in order, and only once their memory fits, so the
+      // piece the writer waits for never waits behind later ones.
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      for (;;) {
+        while (this->_nextRead < this->_pieces.size() && this->_pieces[this->_nextRead].ready) this->_nextRead++;
+        if (this->_failed || this->_nextRead == this->_pieces.size()) return;
+        uint64_t length = this->_pieces[this->_nextRead].length;
+        if (this->_inFlight == 0 || this->_inFlight + length <= this->_memory) break;
+        this->_freed.wait(lock);
+      }
+      piece = &this->_pieces[this->_nextRead++];
+      this->_inFlight += piece->length;
+    }
+
+    try {
+      this->_load(piece);
+    } catch (...) {
+      this->_fail(std::current_exception());
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      piece->ready = true;
+    }
+    this->_loaded.notify_one();
+  }
+}
+
+void PackWriter::_load(Piece* piece) {
+  const Source& source = this->_sources[piece->source];
+  RandomAccessFile file;
+  if (!file.open(source.path)) {
+    throw AsarError(file_error, "Open file failed.");
+  }
+  piece->buffer.reset(new char[piece->length]);
+  // Exactly the size in the header, even if the source changed since it was scanned.
+  if (file.readAt(piece->buffer.get(), piece->length, source.pathOffset + piece->begin) != piece->length) {
+    throw AsarError(file_error, "File changed while packing: " + source.path);
+  }
+  piece->data = piece->buffer.get();
+}
+
+void PackWriter::_fail(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (!this->_error) this->_error = error;
+    this->_failed = true;
+  }
+  this->_loaded.notify_all();
+  this->_freed.notify_all();
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef __ASAR_PACK_WRITER_HPP__
+#define __ASAR_PACK_WRITER_HPP__
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace asar {
+
+class OutputFile;
+
+// Writes the data region of an archive. Reader threads load the files into
+// buffers ahead of the writer, which appends them in order with gathered
+// writes, so many small files cost few system calls and reads overlap with
+// writing. Large files are read in pieces. The buffers loaded but not yet
+// written never exceed the memory limit, except for a single piece.
+class PackWriter {
+ public:
+  struct Source {
+    std::string path;
+    // Where the contents start in the file at path.
+    uint64_t pathOffset;
+    // Used instead of reading path when not null.
+    const char* data;
+    // Relative to the start of the data region; the gap from the previous
+    // file is filled with zeros.
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  static const uint64_t DEFAULT_MEMORY = 64 * 1024 * 1024;
+
+  // threads 0: one per core, memory 0: DEFAULT_MEMORY.
+  static void write(OutputFile* out, const std::vector<Source>& sources, size_t threads = 0, uint64_t memory = 0);
+
+ private:
+  struct Piece {
+    size_t source;
+    uint64_t begin;
+    size_t length;
+    uint64_t padding;
+    std::unique_ptr<char[]> buffer;
+    const char* data;
+    bool ready;
+  };
+
+  PackWriter(const std::vector<Source>& sources, uint64_t memory);
+
+  const std::vector<Source>& _sources;
+  std::vector<Piece> _pieces;
+  uint64_t _memory;
+  std::mutex _mutex;
+  // Signalled when a piece is loaded, and when written pieces free memory.
+  std::condition_variable _loaded;
+  std::condition_variable _freed;
+  size_t _nextRead;
+  uint64_t _inFlight;
+  bool _failed;
+  std::exception_ptr _error;
+
+  void _read();
+  void _load(Piece* piece);
+  void _fail(std::exception_ptr error);
+};
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "ThreadPool.hpp"
+
+namespace asar {
+
+ThreadPool::ThreadPool(size_t threads): _workers(), _tasks(), _mutex(), _ready(), _stopping(false) {
+  if (threads == 0) threads = ThreadPool::defaultSize();
+  this->_workers.reserve(threads);
+  for (size_t i = 0; i < threads; i++) {
+    this->_workers.push_back(std::thread(&ThreadPool::_run, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_stopping = true;
+  }
+  this->_ready.notify_all();
+  for (std::thread& worker : this->_workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_tasks.push_back(std::move(task));
+  }
+  this->_ready.notify_one();
+}
+
+size_t ThreadPool::size() const {
+  return this->_workers.size();
+}
+
+size_t ThreadPool::defaultSize() {
+  size_t n = std::thread::hardware_concurrency();
+  return n < 2 ? 2 : n;
+}
+
+void ThreadPool::_run() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_ready.wait(lock, [this]() { return this->_stopping || !this->_tasks.empty(); });
+      if (this->_tasks.empty()) return;
+      task = std::move(this->_tasks.front());
+      this->_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+}
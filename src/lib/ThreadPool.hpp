@@ -0,0 +1,41 @@
+#ifndef __ASAR_THREAD_POOL_HPP__
+#define __ASAR_THREAD_POOL_HPP__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace asar {
+
+// Fixed set of worker threads running posted tasks in FIFO order.
+// The destructor runs whatever is still queued, then joins the workers.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void post(std::function<void()> task);
+  size_t size() const;
+
+  // Number of workers used when none is given: the hardware concurrency, at least 2.
+  static size_t defaultSize();
+
+ private:
+  std::vector<std::thread> _workers;
+  std::deque<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  bool _stopping;
+
+  void _run();
+};
+
+}
+
+#endif
@@ -18,11 +18,25 @@ struct __asar_context {
   asar::Asar* impl;
 };
 
+struct __asar_stream_context {
+  asar::AsarStream impl;
+};
+
+void asar_open_options_init(asar_open_options_t* options) {
+  memset(options, 0, sizeof(asar_open_options_t));
+}
+
 asar_t* asar_open(const char* asar_path) {
+  return asar_open_ex(asar_path, NULL);
+}
+
+asar_t* asar_open_ex(const char* asar_path, const asar_open_options_t* options) {
+  asar_open_options_t defaults;
+  asar_open_options_init(&defaults);
   asar_t* asar = new asar_t;
   asar->impl = new asar::Asar;
   try {
-    asar->impl->open(asar_path);
+    asar->impl->open(asar_path, options != NULL ? *options : defaults);
   } catch (const asar::AsarError& err) {
     asar__set_last_error(err);
     delete asar->impl;
@@ -89,8 +103,9 @@ int asar_get_header_json_string(asar_t* asar, boolean_t format, char* out, size_
   return headerLength;
 }
 
-asar_status asar_get_node(asar_t* asar, const char* path, asar_node_t* out) {
-  Json::Value node = asar->impl->getNode(path);
+template <typename Node>
+static asar_status asar__get_node(asar_t* asar, const char* path, Node* out, asar::AsarNode* found) {
+  asar::AsarNode node = asar->impl->stat(path);
   if (node.isNull()) {
     code = not_exists;
     memset(msg, 0, sizeof(msg));
@@ -98,34 +113,35 @@ asar_status asar_get_node(asar_t* asar, const char* path, asar_node_t* out) {
     return code;
   }
 
-  if (node.isMember("files")) {
-    out->is_directory = 1;
-    out->size = 0;
-    out->offset = 0;
-    out->unpacked = 0;
-    out->executable = 0;
-    memset(out->link, 0, sizeof(out->link));
-    return ok;
+  out->is_directory = node.isDirectory() ? 1 : 0;
+  out->offset = node.offset();
+  out->unpacked = node.unpacked() ? 1 : 0;
+  out->executable = node.executable() ? 1 : 0;
+  memset(out->link, 0, sizeof(out->link));
+  if (node.isLink()) {
+    size_t length = node.linkLength() < sizeof(out->link) - 1 ? node.linkLength() : sizeof(out->link) - 1;
+    memcpy(out->link, node.link(), length);
   }
+  *found = node;
+  return ok;
+}
 
-  out->is_directory = 0;
-
-  if (node.isMember("link")) {
-    out->size = 0;
-    out->offset = 0;
-    out->unpacked = 0;
-    out->executable = 0;
-    memset(out->link, 0, sizeof(out->link));
-    strcpy(out->link, node["link"].asString().c_str());
-  } else {
-    out->size = node.isMember("size") ? node["size"].asUInt() : 0;
-    out->offset = node.isMember("offset") ? std::strtoull(node["offset"].asString().c_str(), nullptr, 10) : 0;
-    out->unpacked = node.isMember("unpacked") ? (node["unpacked"].asBool() ? 1 : 0) : 0;
-    out->executable = node.isMember("executable") ? (node["executable"].asBool() ? 1 : 0) : 0;
-    memset(out->link, 0, sizeof(out->link));
+asar_status asar_get_node(asar_t* asar, const char* path, asar_node_t* out) {
+  asar::AsarNode node;
+  asar_status r = asar__get_node(asar, path, out, &node);
+  if (r == ok) {
+    out->size = node.size() > 0xFFFFFFFF ? 0xFFFFFFFF : static_cast<uint32_t>(node.size());
   }
+  return r;
+}
 
-  return ok;
+asar_status asar_get_node_ex(asar_t* asar, const char* path, asar_node_ex_t* out) {
+  asar::AsarNode node;
+  asar_status r = asar__get_node(asar, path, out, &node);
+  if (r == ok) {
+    out->size = node.size();
+  }
+  return r;
 }
 
 boolean_t asar_exists(asar_t* asar, const char* path) {
@@ -133,30 +149,154 @@ boolean_t asar_exists(asar_t* asar, const char* path) {
 }
 
 int asar_read_file(asar_t* asar, const char* path, char* out, size_t len) {
-  Json::Value node = asar->impl->getNode(path);
-  if (node.isNull()) {
-    code = not_exists;
-    memset(msg, 0, sizeof(msg));
-    strcpy(msg, ("Cannot get node: " + std::string(path)).c_str());
+  uint64_t size = 0;
+  if (asar_read_file_ex(asar, path, out, len, &size) != ok) {
     return 0;
   }
-  if (node.isMember("files")) {
-    code = not_file;
+  return static_cast<int>(out == nullptr || size < len ? size : len);
+}
+
+asar_status asar_read_file_ex(asar_t* asar, const char* path, char* out, size_t len, uint64_t* size) {
+  *size = 0;
+  try {
+    *size = asar->impl->readFileInto(path, out, len);
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return code;
+  } catch (const std::exception& stdexpt) {
+    code = unknown;
+    memset(msg, 0, sizeof(msg));
+    strcpy(msg, stdexpt.what());
+    return code;
+  }
+  return ok;
+}
+
+asar_status asar_read_file_range(asar_t* asar, const char* path, uint64_t offset, char* out, size_t len, size_t* read) {
+  *read = 0;
+  try {
+    *read = asar->impl->readFile(path, offset, out, len);
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return code;
+  } catch (const std::exception& stdexpt) {
+    code = unknown;
+    memset(msg, 0, sizeof(msg));
+    strcpy(msg, stdexpt.what());
+    return code;
+  }
+  return ok;
+}
+
+asar_status asar_read_files(asar_t* asar, const char* const* paths, size_t count, char* const* outs, const size_t* lens, uint64_t* sizes) {
+  std::vector<std::string> list(paths, paths + count);
+  try {
+    asar->impl->readFiles(list, reinterpret_cast<uint8_t* const*>(outs), lens, sizes);
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return code;
+  } catch (const std::exception& stdexpt) {
+    code = unknown;
+    memset(msg, 0, sizeof(msg));
+    strcpy(msg, stdexpt.what());
+    return code;
+  }
+  return ok;
+}
+
+asar_stream_t* asar_open_stream(asar_t* asar, const char* path) {
+  try {
+    asar::AsarStream stream = asar->impl->openStream(path);
+    asar_stream_t* res = new asar_stream_t;
+    res->impl = stream;
+    return res;
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return NULL;
+  } catch (const std::exception& stdexpt) {
+    code = unknown;
     memset(msg, 0, sizeof(msg));
-    strcpy(msg, ("Not a file: " + std::string(path)).c_str());
+    strcpy(msg, stdexpt.what());
+    return NULL;
+  }
+}
+
+uint64_t asar_stream_size(asar_stream_t* stream) {
+  return stream->impl.size();
+}
+
+size_t asar_stream_read(asar_stream_t* stream, void* buffer, size_t length) {
+  try {
+    return stream->impl.read(buffer, length);
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
     return 0;
   }
-  if (out == nullptr) {
-    return node["size"].asInt();
+}
+
+uint64_t asar_stream_seek(asar_stream_t* stream, int64_t offset, int whence) {
+  try {
+    return stream->impl.seek(offset, whence);
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return stream->impl.tell();
+  }
+}
+
+void asar_close_stream(asar_stream_t* stream) {
+  delete stream;
+}
+
+asar_status asar_read_file_async(asar_t* asar, const char* path, asar_read_callback_t callback, void* user_data) {
+  try {
+    asar->impl->readFileAsync(path, [callback, user_data](std::exception_ptr error, std::vector<uint8_t>& data) {
+      if (!error) {
+        callback(user_data, ok, reinterpret_cast<const char*>(data.data()), data.size());
+        return;
+      }
+      // The last-error slot is shared with the caller's thread, so only the status is reported.
+      asar_status status = unknown;
+      try {
+        std::rethrow_exception(error);
+      } catch (const asar::AsarError& err) {
+        status = err.code();
+      } catch (const std::exception&) {}
+      callback(user_data, status, NULL, 0);
+    });
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return code;
+  } catch (const std::exception& stdexpt) {
+    code = unknown;
+    memset(msg, 0, sizeof(msg));
+    strcpy(msg, stdexpt.what());
+    return code;
   }
-  auto buffer = asar->impl->readFile(path);
-  auto size = buffer.size();
-  if (size > len) {
-    memcpy(out, buffer.data(), len);
-    return len;
+  return ok;
+}
+
+void asar_get_cache_stats(asar_t* asar, asar_cache_stats_t* out) {
+  *out = asar->impl->cacheStats();
+}
+
+void asar_prefetch(asar_t* asar, const char* const* paths, size_t count) {
+  std::vector<std::string> list(paths, paths + count);
+  asar->impl->prefetch(list);
+}
+
+asar_status asar_write_access_order(asar_t* asar, const char* path) {
+  try {
+    asar->impl->writeAccessOrder(path);
+  } catch (const asar::AsarError& err) {
+    asar__set_last_error(err);
+    return code;
+  } catch (const std::exception& stdexpt) {
+    code = unknown;
+    memset(msg, 0, sizeof(msg));
+    strcpy(msg, stdexpt.what());
+    return code;
   }
-  memcpy(out, buffer.data(), size);
-  return size;
+  return ok;
 }
 
 void asar_list(asar_t* asar) {
@@ -211,8 +351,22 @@ const char* asar_get_last_error_message() {
 }
 
 asar_status asar_pack(const char* src, const char* dest, const char* unpack, asar_transform_callback_t transform) {
+  asar_pack_options_t options;
+  asar_pack_options_init(&options);
+  options.unpack = unpack;
+  options.transform = transform;
+  return asar_pack_ex(src, dest, &options);
+}
+
+void asar_pack_options_init(asar_pack_options_t* options) {
+  memset(options, 0, sizeof(asar_pack_options_t));
+}
+
+asar_status asar_pack_ex(const char* src, const char* dest, const asar_pack_options_t* options) {
+  asar_pack_options_t defaults;
+  asar_pack_options_init(&defaults);
   try {
-    asar::Asar::pack(src, dest, unpack, transform);
+    asar::Asar::pack(src, dest, options != NULL ? *options : defaults);
   } catch (const asar::AsarError& err) {
     asar__set_last_error(err);
     return code;
@@ -0,0 +1,165 @@
+#include "asar/Asar.hpp"
+#include "asar/AsarError.hpp"
+#include "asar/asar.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Submits every file many times over, plus a range and a missing path, and
+// checks each completion against a synchronous read. Returns the number of
+// mismatched completions.
+static int roundTrip(asar_async_mode mode, const char* asarPath) {
+  asar::Asar reference;
+  reference.open(asarPath);
+  std::vector<std::string> files;
+  std::vector<std::vector<uint8_t>> expected;
+  for (const std::string& path : reference.list()) {
+    if (!reference.stat(path).isFile()) continue;
+    files.push_back(path);
+    expected.push_back(reference.readFile(path));
+  }
+
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  options.async_io = mode;
+  options.async_queue_depth = 16;
+  // Small enough that some files need a buffer of their own.
+  options.async_buffer_size = 64;
+  asar::Asar asar;
+  asar.open(asarPath, options);
+
+  std::vector<asar::AsarReadRequest> requests;
+  for (size_t round = 0; round < 100; round++) {
+    for (size_t i = 0; i < files.size(); i++) {
+      requests.push_back(asar::AsarReadRequest(files[i], round * files.size() + i));
+    }
+  }
+  uint64_t rangeTag = requests.size();
+  uint64_t missingTag = rangeTag + 1;
+  requests.push_back(asar::AsarReadRequest("/file0.txt", rangeTag, 6, 7));
+  requests.push_back(asar::AsarReadRequest("/no/such/file", missingTag));
+  asar.submitReads(requests);
+
+  std::vector<asar::AsarReadCompletion> completions;
+  while (asar.pendingReads() > 0) {
+    asar.reapReads(&completions, 32);
+  }
+
+  int mismatches = completions.size() == requests.size() ? 0 : 1;
+  for (const asar::AsarReadCompletion& completion : completions) {
+    if (completion.userData == missingTag) {
+      if (completion.status != not_exists) mismatches++;
+    } else if (completion.userData == rangeTag) {
+      if (completion.status != ok || std::string(completion.data.begin(), completion.data.end()) != "content") mismatches++;
+    } else if (completion.status != ok || completion.data.toVector() != expected[completion.userData % files.size()]) {
+      mismatches++;
+    }
+  }
+  printf("async read (%s): %d completions, %d mismatches\n", asar.asyncBackend(), static_cast<int>(completions.size()), mismatches);
+  return mismatches;
+}
+
+// Futures from the per-Asar I/O pool must match synchronous reads, and a
+// missing path must surface as an AsarError from get().
+static int futures(const char* asarPath) {
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  options.io_threads = 3;
+  asar::Asar asar;
+  asar.open(asarPath, options);
+
+  std::vector<std::string> files;
+  std::vector<std::future<std::vector<uint8_t>>> pending;
+  for (int round = 0; round < 50; round++) {
+    for (const std::string& path : asar.list()) {
+      if (!asar.stat(path).isFile()) continue;
+      files.push_back(path);
+      pending.push_back(asar.readFileAsync(path));
+    }
+  }
+  std::future<std::vector<uint8_t>> missing = asar.readFileAsync("/no/such/file");
+
+  int mismatches = 0;
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (pending[i].get() != asar.readFile(files[i])) mismatches++;
+  }
+  try {
+    missing.get();
+    mismatches++;
+  } catch (const asar::AsarError& err) {
+    if (err.code() != not_exists) mismatches++;
+  }
+  printf("future read: %d futures, %d mismatches\n", static_cast<int>(pending.size() + 1), mismatches);
+  return mismatches;
+}
+
+struct CallbackResults {
+  explicit CallbackResults(size_t size) : statuses(size, unknown), data(size) {}
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t count = 0;
+  std::vector<asar_status> statuses;
+  std::vector<std::string> data;
+};
+
+struct CallbackSlot {
+  CallbackResults* results;
+  size_t index;
+};
+
+static void onRead(void* userData, asar_status status, const char* data, size_t size) {
+  CallbackSlot* slot = static_cast<CallbackSlot*>(userData);
+  std::lock_guard<std::mutex> lock(slot->results->mutex);
+  slot->results->statuses[slot->index] = status;
+  if (status == ok) slot->results->data[slot->index].assign(data, size);
+  slot->results->count++;
+  slot->results->done.notify_one();
+}
+
+// asar_read_file_async must call back once per path, on its own time, with
+// what asar_read_file returns, or not_exists for a missing path. The results
+// are checked only once every callback has been counted, with the archive
+// still open.
+static int callbacks(const char* asarPath) {
+  asar_t* asar = asar_open(asarPath);
+  if (asar == nullptr) return 1;
+  std::vector<std::string> paths = { "/dir1/file1.txt", "/dir2/file2.png", "/emptyfile.txt", "/dir1/missing.txt" };
+  CallbackResults results(paths.size());
+  std::vector<CallbackSlot> slots;
+  for (size_t i = 0; i < paths.size(); i++) slots.push_back({ &results, i });
+
+  size_t queued = 0;
+  int mismatches = 0;
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (asar_read_file_async(asar, paths[i].c_str(), onRead, &slots[i]) == ok) {
+      queued++;
+    } else {
+      mismatches++;
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(results.mutex);
+    results.done.wait(lock, [&results, queued]() { return results.count == queued; });
+  }
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    int size = asar_read_file(asar, paths[i].c_str(), nullptr, 0);
+    std::string expected(static_cast<size_t>(size), '\0');
+    if (size > 0) asar_read_file(asar, paths[i].c_str(), &expected[0], expected.size());
+    bool exists = asar_exists(asar, paths[i].c_str()) != 0;
+    if (exists ? results.statuses[i] != ok || results.data[i] != expected : results.statuses[i] != not_exists) {
+      printf("callback read %s: status %d, %d bytes\n", paths[i].c_str(), static_cast<int>(results.statuses[i]), static_cast<int>(results.data[i].size()));
+      mismatches++;
+    }
+  }
+  asar_close(asar);
+  printf("callback read: %d callbacks, %d mismatches\n", static_cast<int>(results.count), mismatches);
+  return mismatches;
+}
+
+extern "C" int test_async_read(const char* asarPath) {
+  return roundTrip(async_auto, asarPath) + roundTrip(async_thread_pool, asarPath) + futures(asarPath) + callbacks(asarPath);
+}
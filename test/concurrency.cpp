@@ -0,0 +1,67 @@
+#include "asar/Asar.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Many threads reading through one Asar must all see the bytes a single
+// reader sees. Returns the number of mismatched reads.
+static int stress(const char* label, const char* asarPath, const asar_open_options_t& options, int threads, int iterations) {
+  asar::Asar reference;
+  reference.open(asarPath);
+  std::vector<std::string> files;
+  std::vector<std::vector<uint8_t>> expected;
+  for (const std::string& path : reference.list()) {
+    if (!reference.stat(path).isFile()) continue;
+    files.push_back(path);
+    expected.push_back(reference.readFile(path));
+  }
+
+  // Nothing has been read through this instance yet, so a lazy index is still loading directories while the threads run.
+  asar::Asar asar;
+  asar.open(asarPath, options);
+
+  std::atomic<int> mismatches(0);
+  std::atomic<uint64_t> bytes(0);
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      uint64_t local = 0;
+      for (int i = 0; i < iterations; i++) {
+        size_t n = (static_cast<size_t>(t) * 7 + i) % files.size();
+        std::vector<uint8_t> data = asar.readFile(files[n]);
+        if (data != expected[n]) mismatches++;
+        local += data.size();
+      }
+      bytes += local;
+    }));
+  }
+  for (std::thread& worker : workers) worker.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%s: %d threads x %d reads, %d mismatches, %.0f reads/s, %.1f MiB/s\n",
+    label, threads, iterations, mismatches.load(),
+    threads * iterations / seconds, bytes.load() / seconds / 1048576.0);
+  return mismatches.load();
+}
+
+extern "C" int test_concurrent_read(const char* asarPath) {
+  unsigned int threads = std::thread::hardware_concurrency();
+  if (threads < 4) threads = 4;
+
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  int mismatches = stress("concurrent read (pread)", asarPath, options, static_cast<int>(threads), 20000);
+  options.mmap = 1;
+  mismatches += stress("concurrent read (mmap)", asarPath, options, static_cast<int>(threads), 20000);
+  options.mmap = 0;
+  options.lazy = 1;
+  mismatches += stress("concurrent read (lazy)", asarPath, options, static_cast<int>(threads), 20000);
+  options.lazy = 0;
+  options.cache_bytes = 64 * 1024;
+  mismatches += stress("concurrent read (cache)", asarPath, options, static_cast<int>(threads), 20000);
+  return mismatches;
+}
@@ -0,0 +1,80 @@
+#include "GlobSet.hpp"
+
+#include <cstdio>
+#include <cstdint>
+
+struct GlobCase {
+  const char* glob;
+  const char* path;
+  bool matches;
+};
+
+static const GlobCase CASES[] = {
+  // A glob without a slash matches the last segment at any depth.
+  { "*.png", "file2.png", true },
+  { "*.png", "/dir2/file2.png", true },
+  { "*.png", "dir2.png/file", false },
+  { "?.txt", "a/b.txt", true },
+  { "?.txt", "ab.txt", false },
+  // Braces, nested and with a single alternative left alone.
+  { "*.{png,jpg}", "dir/b.jpg", true },
+  { "*.{png,jpg}", "dir/b.gif", false },
+  { "{a,b{c,d}}.txt", "bd.txt", true },
+  { "{a,b{c,d}}.txt", "b.txt", false },
+  { "{a}.txt", "{a}.txt", true },
+  // ** spans segments, but only as a whole segment.
+  { "**/test/*.js", "test/a.js", true },
+  { "**/test/*.js", "x/y/test/a.js", true },
+  { "**/test/*.js", "test/sub/a.js", false },
+  { "**/test/*.js", "xtest/a.js", false },
+  { "node_modules/**", "node_modules/a/b/c.js", true },
+  { "a/**b", "a/x/b", false },
+  { "dir2/file3.*", "/dir2/file3.txt", true },
+  { "dir2/file3.*", "x/dir2/file3.txt", false },
+  // Classes, ranges, negation and a literal '['.
+  { "file[0-2].txt", "file0.txt", true },
+  { "file[0-2].txt", "file2.txt", true },
+  { "file[0-2].txt", "file3.txt", false },
+  { "[!.]*", ".hiddenfile.txt", false },
+  { "[!.]*", "file0.txt", true },
+  { "[]]", "]", true },
+  { "a/[/]b", "a//b", false },
+  { "x[y", "x[y", true },
+  { "\\*", "*", true },
+  { "\\*", "a", false },
+};
+
+// Matches the globs one by one, then all together, where a path must carry
+// the tags of exactly the globs that match it on their own. Returns the
+// number of wrong answers.
+extern "C" int test_glob_set() {
+  const size_t count = sizeof(CASES) / sizeof(CASES[0]);
+  int failures = 0;
+  for (size_t i = 0; i < count; i++) {
+    asar::GlobSet set;
+    set.add(CASES[i].glob, 1);
+    if ((set.match(CASES[i].path) != 0) != CASES[i].matches) {
+      printf("glob %s on %s: expected %s\n", CASES[i].glob, CASES[i].path, CASES[i].matches ? "match" : "no match");
+      failures++;
+    }
+  }
+
+  asar::GlobSet all;
+  const size_t TAGGED = 8;
+  for (size_t i = 0; i < TAGGED; i++) all.add(CASES[i].glob, UINT32_C(1) << i);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t expected = 0;
+    for (size_t j = 0; j < TAGGED; j++) {
+      asar::GlobSet one;
+      one.add(CASES[j].glob, 1);
+      if (one.match(CASES[i].path) != 0) expected |= UINT32_C(1) << j;
+    }
+    if (all.match(CASES[i].path) != expected) {
+      printf("glob set on %s: tags %u, expected %u\n", CASES[i].path, (unsigned)all.match(CASES[i].path), (unsigned)expected);
+      failures++;
+    }
+  }
+
+  printf("glob set: %d cases, %d failures\n", (int)count, failures);
+  return failures;
+}
@@ -0,0 +1,54 @@
+#include "asar/Asar.hpp"
+#include "asar/AsarError.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Lookups through the hash table must find exactly the nodes a walk finds,
+// for every entry, for other spellings of it, and for near misses.
+static int compare(const char* asarPath) {
+  asar::Asar walk;
+  walk.open(asarPath);
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  options.hash_index = 1;
+  asar::Asar hashed;
+  hashed.open(asarPath, options);
+
+  std::vector<std::string> queries;
+  for (const std::string& path : walk.list()) {
+    queries.push_back(path);
+    queries.push_back("." + path + "/");
+    queries.push_back("\\x\\..\\" + path.substr(1));
+    queries.push_back(path + ".missing");
+    queries.push_back(path + "/missing");
+    queries.push_back(path.substr(0, path.size() - 1));
+  }
+  queries.push_back("/");
+  queries.push_back("");
+
+  int mismatches = 0;
+  for (const std::string& query : queries) {
+    asar::AsarNode expected = walk.stat(query);
+    asar::AsarNode found = hashed.stat(query);
+    if (expected.id() != found.id()) {
+      printf("hash index %s: %s found %d, walk %d\n", asarPath, query.c_str(), (int)found.id(), (int)expected.id());
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+extern "C" int test_hash_index(const char* firstAsar, const char* secondAsar) {
+  int mismatches = 0;
+  try {
+    mismatches += compare(firstAsar);
+    mismatches += compare(secondAsar);
+  } catch (const std::exception& e) {
+    printf("hash index: %s\n", e.what());
+    mismatches++;
+  }
+  printf("hash index: %d mismatches\n", mismatches);
+  return mismatches;
+}
@@ -0,0 +1,286 @@
+#include "asar/Asar.hpp"
+#include "asar/AsarError.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static void makeDir(const std::string& path) {
+#ifdef _WIN32
+  _mkdir(path.c_str());
+#else
+  mkdir(path.c_str(), 0777);
+#endif
+}
+
+static std::vector<std::string> listDir(const std::string& path) {
+  std::vector<std::string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA((path + "\\*").c_str(), &data);
+  if (find == INVALID_HANDLE_VALUE) return names;
+  do {
+    if (data.cFileName[0] != '.') names.push_back(data.cFileName);
+  } while (FindNextFileA(find, &data));
+  FindClose(find);
+#else
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) return names;
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+  }
+  closedir(dir);
+#endif
+  return names;
+}
+
+static std::vector<char> readAll(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeAll(const std::string& path, const std::vector<char>& data) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Everything a lookup can return for every entry, as one string.
+static std::string describe(const asar::AsarIndex& index, const std::vector<std::string>& paths) {
+  std::string out = index.toJson();
+  for (const std::string& path : paths) {
+    uint32_t id = index.find(path);
+    out += "\n" + path + " " + std::to_string(id);
+    if (id == asar::AsarIndex::npos) continue;
+    const asar::AsarIndex::Entry& entry = index.at(id);
+    out += " " + std::to_string(entry.flags) + " " + std::to_string(entry.size) + " " + std::to_string(entry.offset);
+    if (!(entry.flags & asar::AsarIndex::FLAG_DIRECTORY)) continue;
+    for (const std::string& name : index.readdir(path)) out += " " + name;
+  }
+  return out;
+}
+
+static std::string describe(const asar::Asar& asar, const std::vector<std::string>& paths) {
+  std::string out = asar.getHeaderJsonString();
+  for (const std::string& path : paths) {
+    asar::AsarNode node = asar.stat(path);
+    out += "\n" + path + (node.isNull() ? " missing" : node.isDirectory() ? " dir" : node.isLink() ? " link" : " file");
+    if (node.isDirectory()) {
+      for (const std::string& name : asar.readdir(path)) out += " " + name;
+    } else if (node.isFile() && node.unpacked()) {
+      out += " unpacked " + std::to_string(node.size());
+    } else if (node.isFile()) {
+      std::vector<uint8_t> data = asar.readFile(path);
+      out += " " + std::to_string(node.size()) + " " + std::string(data.begin(), data.end());
+    }
+  }
+  return out;
+}
+
+static bool opens(const std::string& path, const asar_open_options_t& options, std::string* description, const std::vector<std::string>& paths) {
+  try {
+    asar::Asar asar;
+    asar.open(path, options);
+    *description = describe(asar, paths);
+    return true;
+  } catch (const std::exception& e) {
+    printf("index cache: open %s failed: %s\n", path.c_str(), e.what());
+    return false;
+  }
+}
+
+// Saves and loads an index directly: a good file round-trips, a stale key
+// is refused, and truncated or damaged files are refused or, when a byte
+// only changes a name, still load into an index that can be walked.
+static int roundTrip(const std::string& asarPath, const std::string& idxPath) {
+  asar::Asar reference;
+  reference.open(asarPath);
+  std::vector<std::string> paths = reference.list();
+  paths.push_back("/no/such/file");
+  std::string json = reference.getHeaderJsonString();
+  uint64_t dataOffset = 8 + static_cast<uint64_t>(reference.getHeaderSize());
+  uint64_t fileSize = reference.getFileSize();
+  asar::AsarIndex parsed = asar::AsarIndex::parse(json.data(), json.size(), dataOffset, fileSize);
+
+  int failures = 0;
+  asar::AsarIndex::CacheKey key = { fileSize, 1234, 5678 };
+  parsed.save(idxPath, key);
+  asar::AsarIndex loaded;
+  if (!asar::AsarIndex::load(idxPath, key, dataOffset, fileSize, &loaded) || describe(loaded, paths) != describe(parsed, paths)) {
+    printf("index cache: saved index does not load back\n");
+    failures++;
+  }
+
+  asar::AsarIndex::CacheKey stale[3] = { key, key, key };
+  stale[0].archiveSize++;
+  stale[1].archiveMtime++;
+  stale[2].headerHash++;
+  for (const asar::AsarIndex::CacheKey& other : stale) {
+    if (asar::AsarIndex::load(idxPath, other, dataOffset, fileSize, &loaded)) {
+      printf("index cache: loaded with a stale key\n");
+      failures++;
+    }
+  }
+  if (asar::AsarIndex::load(idxPath, key, dataOffset, dataOffset, &loaded)) {
+    printf("index cache: loaded entries past the end of the archive\n");
+    failures++;
+  }
+
+  std::vector<char> good = readAll(idxPath);
+  std::string damagedPath = idxPath + ".damaged";
+  for (size_t length = 0; length < good.size(); length += length < 64 ? 1 : 37) {
+    writeAll(damagedPath, std::vector<char>(good.begin(), good.begin() + length));
+    if (asar::AsarIndex::load(damagedPath, key, dataOffset, fileSize, &loaded)) {
+      printf("index cache: loaded a file truncated to %d bytes\n", (int)length);
+      failures++;
+    }
+  }
+  for (size_t i = 0; i < good.size(); i++) {
+    std::vector<char> damaged(good);
+    damaged[i] = static_cast<char>(damaged[i] ^ 0xA5);
+    writeAll(damagedPath, damaged);
+    if (asar::AsarIndex::load(damagedPath, key, dataOffset, fileSize, &loaded)) {
+      // Accepted: every reference was in bounds, so walking it must be safe.
+      try {
+        describe(loaded, paths);
+      } catch (const std::exception&) {}
+      for (const std::string& path : paths) {
+        uint32_t id = loaded.find(path);
+        if (id != asar::AsarIndex::npos && loaded.at(id).offset + loaded.at(id).size > fileSize &&
+            !(loaded.at(id).flags & (asar::AsarIndex::FLAG_DIRECTORY | asar::AsarIndex::FLAG_LINK | asar::AsarIndex::FLAG_UNPACKED))) {
+          printf("index cache: byte %d let %s point past the archive\n", (int)i, path.c_str());
+          failures++;
+        }
+      }
+    }
+  }
+  return failures;
+}
+
+// The cache as open uses it: a second open loads it, a changed archive
+// replaces it, a damaged one is parsed around, and index_cache_dir names
+// the file after the archive.
+extern "C" int test_index_cache(const char* asarPath, const char* inputDir, const char* dir) {
+  std::string root = dir;
+  makeDir(root);
+  makeDir(root + "/a");
+  makeDir(root + "/b");
+  makeDir(root + "/cache");
+  std::string archive = root + "/a/cached.asar";
+  std::string idx = archive + ".idx";
+  writeAll(archive, readAll(asarPath));
+
+  int failures = 0;
+  try {
+    failures += roundTrip(archive, root + "/direct.idx");
+  } catch (const std::exception& e) {
+    printf("index cache: %s\n", e.what());
+    failures++;
+  }
+
+  asar::Asar reference;
+  reference.open(archive);
+  std::vector<std::string> paths = reference.list();
+  paths.push_back("/no/such/file");
+  std::string expected = describe(reference, paths);
+  reference.close();
+
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  options.index_cache = 1;
+  std::string first;
+  std::string second;
+  if (!opens(archive, options, &first, paths) || !opens(archive, options, &second, paths) ||
+      first != expected || second != expected || readAll(idx).empty()) {
+    printf("index cache: cached open differs from a plain one\n");
+    failures++;
+  }
+
+  // A name changed only in the cache shows through, so the second open really maps it.
+  std::vector<char> bytes = readAll(idx);
+  std::string marker = "file0.txt";
+  auto found = std::search(bytes.begin(), bytes.end(), marker.begin(), marker.end());
+  std::string poked;
+  if (found == bytes.end()) {
+    printf("index cache: no file0.txt in the cache file\n");
+    failures++;
+  } else {
+    *(found + 8) = 'x';
+    writeAll(idx, bytes);
+    if (!opens(archive, options, &poked, paths) || poked.find("\n/file0.txt missing") == std::string::npos ||
+        poked.find("\"file0.txx\"") == std::string::npos) {
+      printf("index cache: second open did not use the cache file\n");
+      failures++;
+    }
+  }
+
+  // A different archive at the same path makes the cache stale: it is parsed again and rewritten.
+  asar_pack_options_t pack;
+  asar_pack_options_init(&pack);
+  pack.unpack = "*.txt";
+  if (asar_pack_ex(inputDir, archive.c_str(), &pack) != ok) {
+    printf("index cache: repack failed: %s\n", asar_get_last_error_message());
+    return failures + 1;
+  }
+  reference.open(archive);
+  paths = reference.list();
+  expected = describe(reference, paths);
+  reference.close();
+  std::string stale;
+  std::string rewritten;
+  bytes = readAll(idx);
+  if (!opens(archive, options, &stale, paths) || stale != expected ||
+      readAll(idx) == bytes || !opens(archive, options, &rewritten, paths) || rewritten != expected) {
+    printf("index cache: stale cache was used or not replaced\n");
+    failures++;
+  }
+
+  // Truncated and garbage caches are refused, and the archive is parsed instead.
+  bytes = readAll(idx);
+  std::vector<std::vector<char>> damaged;
+  damaged.push_back(std::vector<char>(bytes.begin(), bytes.begin() + bytes.size() / 2));
+  damaged.push_back(std::vector<char>(bytes.size(), '\xFF'));
+  damaged.push_back(std::vector<char>());
+  for (const std::vector<char>& data : damaged) {
+    writeAll(idx, data);
+    std::string description;
+    if (!opens(archive, options, &description, paths) || description != expected) {
+      printf("index cache: damaged cache of %d bytes was not refused\n", (int)data.size());
+      failures++;
+    }
+  }
+
+  // index_cache_dir holds one file per archive, named after it and its full path.
+  std::string other = root + "/b/cached.asar";
+  writeAll(other, readAll(archive));
+  std::string cacheDir = root + "/cache";
+  options.index_cache_dir = cacheDir.c_str();
+  std::string unused;
+  if (!opens(archive, options, &unused, paths) || !opens(other, options, &unused, paths)) {
+    failures++;
+  }
+  std::vector<std::string> names = listDir(cacheDir);
+  bool named = names.size() == 2 && names[0] != names[1];
+  for (const std::string& name : names) {
+    named = named && name.size() == std::strlen("cached.asar-") + 16 + 4 &&
+      name.compare(0, 12, "cached.asar-") == 0 && name.compare(name.size() - 4, 4, ".idx") == 0;
+  }
+  if (!named || !readAll(other + ".idx").empty()) {
+    printf("index cache: index_cache_dir holds %d files\n", (int)names.size());
+    failures++;
+  }
+
+  printf("index cache: %d failures\n", failures);
+  return failures;
+}
@@ -0,0 +1,111 @@
+#include "asar/Asar.hpp"
+#include "asar/AsarError.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Nested directories, an empty one, and keys given twice, as a file and as
+// a directory, so the lazy index has to agree with the eager one on which wins.
+static const char HEADER[] =
+  "{\"files\":{"
+    "\"a\":{\"files\":{"
+      "\"b\":{\"files\":{"
+        "\"c.txt\":{\"size\":3,\"offset\":\"0\"},"
+        "\"deep\":{\"files\":{\"d.txt\":{\"size\":2,\"offset\":\"3\"}}}"
+      "}},"
+      "\"empty\":{\"files\":{}},"
+      "\"dup.txt\":{\"size\":1,\"offset\":\"5\"},"
+      "\"dup.txt\":{\"size\":2,\"offset\":\"6\"}"
+    "}},"
+    "\"dir\":{\"files\":{\"x.txt\":{\"size\":1,\"offset\":\"8\"}}},"
+    "\"dir\":{\"files\":{\"y.txt\":{\"size\":1,\"offset\":\"9\"},\"z\":{\"files\":{}}}},"
+    "\"top.txt\":{\"size\":4,\"offset\":\"10\"}"
+  "}}";
+static const char DATA[] = "abcdefghijklmn";
+
+static void putUInt32(std::string* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+static void writeArchive(const std::string& path) {
+  uint32_t length = static_cast<uint32_t>(strlen(HEADER));
+  uint32_t padded = (length + 3) / 4 * 4;
+  std::string archive;
+  putUInt32(&archive, 4);
+  putUInt32(&archive, 8 + padded);
+  putUInt32(&archive, 4 + padded);
+  putUInt32(&archive, length);
+  archive += HEADER;
+  archive.append(padded - length, '\0');
+  archive += DATA;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(archive.data(), static_cast<std::streamsize>(archive.size()));
+}
+
+// What readdir, stat and readFile return for a path, as one string.
+static std::string describe(const asar::Asar& asar, const std::string& path) {
+  asar::AsarNode node = asar.stat(path);
+  if (node.isNull()) return path + " missing";
+  std::string out = path + (node.isDirectory() ? " dir" : node.isLink() ? " link" : " file") +
+    " " + std::to_string(node.size()) + " " + std::to_string(node.offset()) + " " + std::to_string(node.unpacked());
+  if (node.isDirectory()) {
+    for (const std::string& name : asar.readdir(path)) out += " " + name;
+  } else if (node.isFile() && !node.unpacked()) {
+    std::vector<uint8_t> data = asar.readFile(path);
+    out += " " + std::string(data.begin(), data.end());
+  }
+  return out;
+}
+
+static int compare(const char* asarPath, const std::vector<std::string>& extra) {
+  asar::Asar eager;
+  eager.open(asarPath);
+  std::vector<std::string> paths = eager.list();
+  paths.insert(paths.end(), extra.begin(), extra.end());
+
+  asar_open_options_t options;
+  asar_open_options_init(&options);
+  options.lazy = 1;
+  int mismatches = 0;
+
+  // Each path first, on an index where nothing below the root is expanded yet.
+  for (const std::string& path : paths) {
+    asar::Asar lazy;
+    lazy.open(asarPath, options);
+    if (describe(lazy, path) != describe(eager, path)) {
+      printf("lazy %s: %s, eager: %s\n", asarPath, describe(lazy, path).c_str(), describe(eager, path).c_str());
+      mismatches++;
+    }
+  }
+
+  // The whole header first, then every path on the now expanded index.
+  asar::Asar lazy;
+  lazy.open(asarPath, options);
+  if (lazy.getHeaderJsonString() != eager.getHeaderJsonString() || lazy.list() != eager.list()) {
+    printf("lazy %s: header differs\n", asarPath);
+    mismatches++;
+  }
+  for (const std::string& path : paths) {
+    if (describe(lazy, path) != describe(eager, path)) mismatches++;
+  }
+  return mismatches;
+}
+
+// A lazily parsed index must answer exactly as the eager one, whether a
+// directory is reached directly or after its parents were expanded.
+extern "C" int test_lazy_index(const char* packedAsar, const char* craftedAsar) {
+  int mismatches = 0;
+  try {
+    writeArchive(craftedAsar);
+    mismatches += compare(craftedAsar, { "/a/b/deep", "/a/empty", "/a/empty/none", "/dir/x.txt", "/dir/z", "/a/b/deep/d.txt/x" });
+    mismatches += compare(packedAsar, { "/dir2/subdir/missing", "/dir1/file1.txt/x" });
+  } catch (const std::exception& e) {
+    printf("lazy index: %s\n", e.what());
+    mismatches++;
+  }
+  printf("lazy index: %d mismatches\n", mismatches);
+  return mismatches;
+}
@@ -0,0 +1,30 @@
+#include "asar/Asar.hpp"
+#include "asar/AsarError.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+// Every file mapped on its own must match a normal read, and the files
+// packed with alignment must be mapped from a page boundary. With
+// requireAligned, an archive without any aligned file fails too.
+extern "C" int test_map_file(const char* asarPath, int requireAligned) {
+  asar::Asar asar;
+  asar.open(asarPath);
+
+  int mismatches = 0;
+  int aligned = 0;
+  for (const std::string& path : asar.list()) {
+    asar::AsarNode node = asar.stat(path);
+    if (!node.isFile()) continue;
+    asar::AsarView view = asar.mapFile(path);
+    if (view.toVector() != asar.readFile(path)) mismatches++;
+    if (!node.unpacked() && node.size() > 0 && node.position() % 4096 == 0) {
+      aligned++;
+      if (reinterpret_cast<uintptr_t>(view.data()) % 4096 != 0) mismatches++;
+    }
+  }
+  printf("map file: %d aligned, %d mismatches\n", aligned, mismatches);
+  if (requireAligned && aligned == 0) return 1;
+  return mismatches;
+}
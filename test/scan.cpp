@@ -0,0 +1,65 @@
+#include "asar/asar.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static void makeDir(const std::string& path) {
+#ifdef _WIN32
+  _mkdir(path.c_str());
+#else
+  mkdir(path.c_str(), 0777);
+#endif
+}
+
+static std::vector<char> readAll(const char* path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Four levels of four directories, with a few files in each, so that
+// workers run out of their own tasks and steal from each other.
+static void makeTree(const std::string& dir, int depth, int* count) {
+  makeDir(dir);
+  for (int i = 0; i < 3; i++) {
+    std::ofstream out(dir + "/file" + std::to_string(i) + ".txt", std::ios::binary);
+    out << dir << " " << i;
+  }
+  if (depth == 0) return;
+  for (int i = 0; i < 4; i++) {
+    (*count)++;
+    makeTree(dir + "/dir" + std::to_string(i), depth - 1, count);
+  }
+}
+
+// A parallel scan must give the same archive, byte for byte, as a scan on one thread.
+extern "C" int test_parallel_scan(const char* dir, const char* parallelAsar, const char* sequentialAsar) {
+  int directories = 0;
+  makeTree(dir, 4, &directories);
+
+  asar_pack_options_t options;
+  asar_pack_options_init(&options);
+  options.scan_threads = 8;
+  if (asar_pack_ex(dir, parallelAsar, &options) != ok) {
+    printf("parallel scan: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  options.scan_threads = 1;
+  if (asar_pack_ex(dir, sequentialAsar, &options) != ok) {
+    printf("sequential scan: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+
+  std::vector<char> parallel = readAll(parallelAsar);
+  bool same = !parallel.empty() && parallel == readAll(sequentialAsar);
+  printf("parallel scan of %d directories: %s\n", directories, same ? "identical" : "different");
+  return same ? 0 : 1;
+}
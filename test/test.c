@@ -1,6 +1,8 @@
 #ifdef _WIN32
 #include <Windows.h>
 #include <wchar.h>
+#else
+#include <unistd.h>
 #endif
 
 #include <stdio.h>
@@ -9,6 +11,15 @@
 #include <string.h>
 #include "asar/asar.h"
 
+int test_concurrent_read(const char* asar_path);
+int test_async_read(const char* asar_path);
+int test_map_file(const char* asar_path, int require_aligned);
+int test_glob_set(void);
+int test_lazy_index(const char* packed_asar, const char* crafted_asar);
+int test_hash_index(const char* first_asar, const char* second_asar);
+int test_index_cache(const char* asar_path, const char* input_dir, const char* dir);
+int test_parallel_scan(const char* dir, const char* parallel_asar, const char* sequential_asar);
+
 static void transform(const char* src, const char* tmp_path) {
   printf("src: %s\n", src);
   printf("tmp: %s\n", tmp_path);
@@ -25,6 +36,110 @@ static void transform(const char* src, const char* tmp_path) {
   fclose(sf);
 }
 
+static boolean_t transform_buffer(const char* path, const char* data, size_t size, char** out, size_t* out_size, void* user_data) {
+  size_t len = strlen(path);
+  if (len < 4 || strcmp(path + len - 4, ".txt") != 0) return 0;
+  *out = (char*)malloc(size + 6);
+  if (size > 0) memcpy(*out, data, size);
+  memcpy(*out + size, "append", 6);
+  *out_size = size + 6;
+  ++*(int*)user_data;
+  return 1;
+}
+
+/* replaces text files with nothing, handing back no buffer at all */
+static boolean_t empty_text(const char* path, const char* data, size_t size, char** out, size_t* out_size, void* user_data) {
+  size_t len = strlen(path);
+  (void)data;
+  (void)size;
+  (void)user_data;
+  if (len < 4 || strcmp(path + len - 4, ".txt") != 0) return 0;
+  *out = NULL;
+  *out_size = 0;
+  return 1;
+}
+
+/* empties another source file after its size went into the header */
+static boolean_t shrink_source(const char* path, const char* data, size_t size, char** out, size_t* out_size, void* user_data) {
+  (void)path;
+  (void)data;
+  (void)size;
+  (void)out;
+  (void)out_size;
+  FILE* f = fopen((const char*)user_data, "wb");
+  if (f != NULL) fclose(f);
+  return 0;
+}
+
+static int same_file(const char* a, const char* b) {
+  FILE* fa = fopen(a, "rb");
+  FILE* fb = fopen(b, "rb");
+  int same = fa != NULL && fb != NULL;
+  while (same) {
+    int ca = fgetc(fa);
+    int cb = fgetc(fb);
+    same = ca == cb;
+    if (ca == EOF) break;
+  }
+  if (fa != NULL) fclose(fa);
+  if (fb != NULL) fclose(fb);
+  return same;
+}
+
+static int write_file(const char* path, const void* data, size_t size) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL) return 0;
+  int written = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && written;
+}
+
+/* the whole file through asar_read_file, to check the other read paths against */
+static char* read_whole(asar_t* asar, const char* path, size_t* size) {
+  *size = (size_t)asar_read_file(asar, path, NULL, 0);
+  char* data = (char*)malloc(*size + 1);
+  *size = (size_t)asar_read_file(asar, path, data, *size);
+  data[*size] = '\0';
+  return data;
+}
+
+/* data must be the first size bytes of the file, and the file no longer than total */
+static int matches_read_file(asar_t* asar, const char* path, const char* data, size_t size, uint64_t total) {
+  size_t expected_size;
+  char* expected = read_whole(asar, path, &expected_size);
+  int same = expected_size == total && size <= expected_size && memcmp(expected, data, size) == 0;
+  free(expected);
+  if (!same) printf("%s differs from asar_read_file\n", path);
+  return same;
+}
+
+/* reads the stream to its end, then seeks around in it, comparing every read with expected */
+static int stream_matches(asar_stream_t* stream, const char* expected, size_t size) {
+  char chunk[64];
+  size_t read;
+  size_t total = 0;
+  if (asar_stream_size(stream) != size) return 0;
+  while ((read = asar_stream_read(stream, chunk, sizeof(chunk))) > 0) {
+    if (total + read > size || memcmp(chunk, expected + total, read) != 0) return 0;
+    total += read;
+  }
+  if (total != size) return 0;
+
+  const int64_t offsets[4] = { (int64_t)size / 2, -10, -10, 100 };
+  const int whences[4] = { SEEK_SET, SEEK_CUR, SEEK_END, SEEK_END };
+  uint64_t position = total;
+  for (int i = 0; i < 4; i++) {
+    int64_t origin = whences[i] == SEEK_SET ? 0 : whences[i] == SEEK_CUR ? (int64_t)position : (int64_t)size;
+    int64_t target = origin + offsets[i];
+    uint64_t expected_position = target < 0 ? 0 : (uint64_t)target > size ? size : (uint64_t)target;
+    position = asar_stream_seek(stream, offsets[i], whences[i]);
+    if (position != expected_position) return 0;
+    read = asar_stream_read(stream, chunk, 7);
+    if (read != (size - position < 7 ? size - position : 7) || memcmp(chunk, expected + position, read) != 0) return 0;
+    position += read;
+  }
+  return 1;
+}
+
 int main() {
   // asar_pack(ASAR_INPUT_1, ASAR_OUTPUT_1, NULL, NULL);
   asar_pack(ASAR_INPUT_1, ASAR_OUTPUT_2, "*.png", NULL);
@@ -40,6 +155,328 @@ int main() {
   free(buf);
   asar_list(asar);
   asar_extract(asar, "/", ASAR_EXTRACT_1);
+
+  const char* batch[] = { "/file0.txt", "/dir2/file3.txt", "/dir1/file1.txt", "/emptyfile.txt" };
+  char contents[4][32];
+  char* outs[4] = { contents[0], contents[1], contents[2], contents[3] };
+  size_t lens[4] = { 31, 31, 31, 31 };
+  uint64_t sizes[4] = { 0 };
+  memset(contents, 0, sizeof(contents));
+  if (asar_read_files(asar, batch, 4, outs, lens, sizes) != ok) {
+    printf("asar_read_files: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  for (int i = 0; i < 4; i++) {
+    printf("%s (%d): %s\n", batch[i], (int)sizes[i], contents[i]);
+    if (!matches_read_file(asar, batch[i], contents[i], sizes[i] < lens[i] ? (size_t)sizes[i] : lens[i], sizes[i])) {
+      return 1;
+    }
+  }
+
+  uint64_t needed = 0;
+  asar_read_file_ex(asar, "/dir2/subdir/女の子.txt", NULL, 0, &needed);
+  char* whole = (char*)malloc((size_t)needed + 1);
+  if (asar_read_file_ex(asar, "/dir2/subdir/女の子.txt", whole, (size_t)needed, &needed) != ok) {
+    printf("asar_read_file_ex: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  whole[needed] = '\0';
+  printf("/dir2/subdir/女の子.txt (%d): %s\n", (int)needed, whole);
+  int whole_matches = matches_read_file(asar, "/dir2/subdir/女の子.txt", whole, (size_t)needed, needed);
+  free(whole);
+  if (!whole_matches) {
+    return 1;
+  }
+
+  /* ranges inside the file, running past its end and starting at it */
+  size_t file0_size;
+  char* file0 = read_whole(asar, "/file0.txt", &file0_size);
+  const uint64_t range_offsets[3] = { 6, file0_size - 3, file0_size };
+  for (int i = 0; i < 3; i++) {
+    char range[8] = { 0 };
+    size_t range_read = 0;
+    size_t range_expected = file0_size - (size_t)range_offsets[i] < 7 ? file0_size - (size_t)range_offsets[i] : 7;
+    if (asar_read_file_range(asar, "/file0.txt", range_offsets[i], range, 7, &range_read) != ok ||
+        range_read != range_expected || memcmp(range, file0 + range_offsets[i], range_read) != 0) {
+      printf("/file0.txt [%d, +7) differs from asar_read_file\n", (int)range_offsets[i]);
+      free(file0);
+      return 1;
+    }
+    printf("/file0.txt [%d, +7): %.*s\n", (int)range_offsets[i], (int)range_read, range);
+  }
+  free(file0);
+
+  asar_stream_t* stream = asar_open_stream(asar, "/dir2/file2.png");
+  size_t streamed_size;
+  char* streamed_data = read_whole(asar, "/dir2/file2.png", &streamed_size);
   asar_close(asar);
+  /* the stream outlives the archive it was opened on */
+  int streamed = stream != NULL && stream_matches(stream, streamed_data, streamed_size);
+  printf("streamed /dir2/file2.png: %d bytes, %s\n", (int)streamed_size, streamed ? "same as asar_read_file" : "differs from asar_read_file");
+  if (stream != NULL) asar_close_stream(stream);
+  free(streamed_data);
+  if (!streamed) {
+    return 1;
+  }
+
+  /* a header pickle whose payload size is below the string length field,
+     with a string length far past the end of the header */
+  const unsigned char crafted[20] = {
+    4, 0, 0, 0, 12, 0, 0, 0,
+    0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0x7F, '{', '"', 'a', '"'
+  };
+  if (!write_file(ASAR_OUTPUT_8, crafted, sizeof(crafted))) {
+    return 1;
+  }
+  asar_t* crafted_asar = asar_open(ASAR_OUTPUT_8);
+  printf("crafted header: %s\n", crafted_asar == NULL ? asar_get_last_error_message() : "opened");
+  if (crafted_asar != NULL) {
+    asar_close(crafted_asar);
+    return 1;
+  }
+
+#ifndef _WIN32
+  /* sizes come from the opened archive, not from the link that names it */
+  asar_open_options_t link_options;
+  asar_open_options_init(&link_options);
+  link_options.mmap = 1;
+  link_options.index_cache = 1;
+  unlink(ASAR_OUTPUT_9);
+  if (symlink(ASAR_OUTPUT_2, ASAR_OUTPUT_9) != 0) {
+    return 1;
+  }
+  for (int i = 0; i < 2; i++) {
+    asar_t* linked = asar_open_ex(ASAR_OUTPUT_9, &link_options);
+    char linked_content[32] = { 0 };
+    uint64_t linked_size = 0;
+    if (linked == NULL || asar_read_file_ex(linked, "/file0.txt", linked_content, sizeof(linked_content) - 1, &linked_size) != ok) {
+      printf("symlinked archive: %s\n", asar_get_last_error_message());
+      if (linked != NULL) asar_close(linked);
+      return 1;
+    }
+    asar_close(linked);
+    if (i == 1) printf("symlinked archive: /file0.txt (%d): %s\n", (int)linked_size, linked_content);
+  }
+#endif
+
+  if (test_lazy_index(ASAR_OUTPUT_2, ASAR_OUTPUT_10) != 0) {
+    return 1;
+  }
+  if (test_hash_index(ASAR_OUTPUT_2, ASAR_OUTPUT_10) != 0) {
+    return 1;
+  }
+  if (test_index_cache(ASAR_OUTPUT_2, ASAR_INPUT_1, ASAR_INDEX_CACHE_1) != 0) {
+    return 1;
+  }
+
+  asar_open_options_t cached_options;
+  asar_open_options_init(&cached_options);
+  cached_options.cache_bytes = 1024 * 1024;
+  asar_t* cached = asar_open_ex(ASAR_OUTPUT_2, &cached_options);
+  if (cached == NULL) {
+    return 1;
+  }
+  char content[32];
+  uint64_t content_size = 0;
+  asar_cache_stats_t stats;
+  for (int i = 0; i < 3; i++) {
+    asar_read_file_ex(cached, "/file0.txt", content, sizeof(content), &content_size);
+  }
+  asar_read_file_ex(cached, "/dir2/file2.png", content, sizeof(content), &content_size);
+  asar_get_cache_stats(cached, &stats);
+  printf("cache: %d hits, %d misses, %d entries, %d bytes\n", (int)stats.hits, (int)stats.misses, (int)stats.entries, (int)stats.bytes);
+  asar_close(cached);
+  /* the first read of each file misses, the two repeats of /file0.txt hit */
+  if (stats.hits != 2 || stats.misses != 2) {
+    return 1;
+  }
+
+  const char* warm[] = { "/dir2", "/file0.txt", "/no/such/file" };
+  asar_open_options_t advised_options;
+  asar_open_options_init(&advised_options);
+  advised_options.mmap = 1;
+  advised_options.advice = advice_random;
+  advised_options.warm_paths = warm;
+  advised_options.warm_count = 3;
+  asar_t* advised = asar_open_ex(ASAR_OUTPUT_2, &advised_options);
+  if (advised != NULL) {
+    char content[32] = { 0 };
+    uint64_t content_size = 0;
+    asar_extract(advised, "/dir1", ASAR_EXTRACT_1);
+    asar_read_file_ex(advised, "/dir1/file1.txt", content, sizeof(content) - 1, &content_size);
+    printf("advised /dir1/file1.txt (%d): %s\n", (int)content_size, content);
+    asar_close(advised);
+  }
+
+  asar_open_options_t recorded_options;
+  asar_open_options_init(&recorded_options);
+  recorded_options.record_access = 1;
+  asar_t* recorded = asar_open_ex(ASAR_OUTPUT_2, &recorded_options);
+  if (recorded != NULL) {
+    uint64_t size = 0;
+    asar_read_file_ex(recorded, "/dir2/file3.txt", NULL, 0, &size);
+    asar_read_file_ex(recorded, "/file0.txt", NULL, 0, &size);
+    asar_read_file_ex(recorded, "/dir2/file3.txt", NULL, 0, &size);
+    asar_write_access_order(recorded, ASAR_ORDERING_1);
+    asar_close(recorded);
+  }
+
+  asar_pack_options_t pack_options;
+  asar_pack_options_init(&pack_options);
+  pack_options.unpack = "*.png";
+  pack_options.ordering = ASAR_ORDERING_1;
+  pack_options.align_glob = "*.txt";
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_1, &pack_options) != ok) {
+    printf("ordered: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  asar_t* ordered = asar_open(ASAR_OUTPUT_1);
+  asar_node_t first;
+  asar_node_t second;
+  char ordered_content[32] = { 0 };
+  uint64_t ordered_size = 0;
+  asar_get_node(ordered, "/dir2/file3.txt", &first);
+  asar_get_node(ordered, "/file0.txt", &second);
+  asar_read_file_ex(ordered, "/file0.txt", ordered_content, sizeof(ordered_content) - 1, &ordered_size);
+  int aligned = (8 + asar_get_header_size(ordered) + second.offset) % 4096 == 0;
+  asar_close(ordered);
+  printf("ordered: /dir2/file3.txt at %d, /file0.txt at %d: %s\n", (int)first.offset, (int)second.offset, ordered_content);
+  printf("aligned: %s\n", aligned ? "yes" : "no");
+  if (first.offset != 0 || second.offset == 0 || !aligned) {
+    return 1;
+  }
+  if (test_map_file(ASAR_OUTPUT_1, 1) != 0) {
+    return 1;
+  }
+
+  asar_pack_options_init(&pack_options);
+  pack_options.unpack = "*.png";
+  pack_options.scan_threads = 1;
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_4, &pack_options) != ok || !same_file(ASAR_OUTPUT_2, ASAR_OUTPUT_4)) {
+    printf("sequential scan: different\n");
+    return 1;
+  }
+  printf("sequential scan: identical\n");
+  if (test_parallel_scan(ASAR_INPUT_2, ASAR_OUTPUT_6, ASAR_OUTPUT_7) != 0) {
+    return 1;
+  }
+
+  asar_pack_options_init(&pack_options);
+  pack_options.unpack = "*.png";
+  pack_options.write_threads = 2;
+  pack_options.write_memory = 16;
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_4, &pack_options) != ok || !same_file(ASAR_OUTPUT_2, ASAR_OUTPUT_4)) {
+    printf("bounded writer: different\n");
+    return 1;
+  }
+  printf("bounded writer: identical\n");
+
+  asar_pack_options_init(&pack_options);
+  pack_options.transform_buffer = shrink_source;
+  pack_options.transform_user_data = (void*)(ASAR_INPUT_2 "/file0.txt");
+  if (asar_pack_ex(ASAR_INPUT_2, ASAR_OUTPUT_6, &pack_options) != file_error ||
+      strstr(asar_get_last_error_message(), "File changed while packing") == NULL) {
+    printf("shrunk source: not detected\n");
+    return 1;
+  }
+  printf("shrunk source: %s\n", asar_get_last_error_message());
+
+  const char* unpack_globs[] = { "*.png", "dir2/file3.*" };
+  const char* unpack_dirs[] = { "subdir" };
+  const char* exclude[] = { "dir1", ".*" };
+  asar_pack_options_init(&pack_options);
+  pack_options.unpack_globs = unpack_globs;
+  pack_options.unpack_glob_count = 2;
+  pack_options.unpack_dirs = unpack_dirs;
+  pack_options.unpack_dir_count = 1;
+  pack_options.exclude = exclude;
+  pack_options.exclude_count = 2;
+  if (test_glob_set() != 0) {
+    return 1;
+  }
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_5, &pack_options) != ok) {
+    printf("filtered: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  asar_t* filtered = asar_open(ASAR_OUTPUT_5);
+  asar_node_t png;
+  asar_node_t txt;
+  asar_node_t sub;
+  asar_node_t subdir;
+  int dir1_kept = asar_exists(filtered, "/dir1");
+  int hidden_kept = asar_exists(filtered, "/.hiddenfile.txt");
+  asar_get_node(filtered, "/dir2/file2.png", &png);
+  asar_get_node(filtered, "/dir2/file3.txt", &txt);
+  asar_get_node(filtered, "/dir2/subdir/女の子.txt", &sub);
+  asar_get_node(filtered, "/dir2/subdir", &subdir);
+  asar_close(filtered);
+  printf("filtered: dir1 %s, .hiddenfile.txt %s, unpacked %d%d%d, subdir %d\n",
+    dir1_kept ? "kept" : "excluded", hidden_kept ? "kept" : "excluded",
+    png.unpacked, txt.unpacked, sub.unpacked, subdir.unpacked);
+  if (dir1_kept || hidden_kept || !png.unpacked || !txt.unpacked || !sub.unpacked || !subdir.unpacked) {
+    return 1;
+  }
+
+  int transformed = 0;
+  asar_pack_options_init(&pack_options);
+  pack_options.unpack = "*.png";
+  pack_options.transform_buffer = transform_buffer;
+  pack_options.transform_user_data = &transformed;
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_3, &pack_options) == ok) {
+    asar_t* transformed_asar = asar_open(ASAR_OUTPUT_3);
+    char content[32] = { 0 };
+    uint64_t content_size = 0;
+    asar_read_file_ex(transformed_asar, "/dir1/file1.txt", content, sizeof(content) - 1, &content_size);
+    printf("transformed %d files, /dir1/file1.txt (%d): %s\n", transformed, (int)content_size, content);
+    asar_close(transformed_asar);
+  }
+
+  /* with 16 bytes of memory most replaced contents go through the temporary file */
+  pack_options.write_memory = 16;
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_4, &pack_options) != ok || !same_file(ASAR_OUTPUT_3, ASAR_OUTPUT_4)) {
+    printf("spilled transform: different\n");
+    return 1;
+  }
+  pack_options.unpack = "*.txt";
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_4, &pack_options) != ok) {
+    printf("spilled transform: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  asar_t* spilled = asar_open(ASAR_OUTPUT_4);
+  char spilled_content[32] = { 0 };
+  uint64_t spilled_size = 0;
+  asar_node_t spilled_node;
+  asar_get_node(spilled, "/dir1/file1.txt", &spilled_node);
+  asar_read_file_ex(spilled, "/dir1/file1.txt", spilled_content, sizeof(spilled_content) - 1, &spilled_size);
+  asar_close(spilled);
+  printf("spilled transform: identical, unpacked /dir1/file1.txt (%d): %s\n", (int)spilled_size, spilled_content);
+  if (!spilled_node.unpacked || strstr(spilled_content, "append") == NULL) {
+    return 1;
+  }
+
+  /* an unpacked file replaced by nothing is written empty, not copied from the source */
+  pack_options.transform_buffer = empty_text;
+  if (asar_pack_ex(ASAR_INPUT_1, ASAR_OUTPUT_4, &pack_options) != ok) {
+    printf("emptied transform: %s\n", asar_get_last_error_message());
+    return 1;
+  }
+  asar_t* emptied = asar_open(ASAR_OUTPUT_4);
+  char emptied_content[32] = { 0 };
+  uint64_t emptied_size = 0;
+  asar_node_t emptied_node;
+  asar_get_node(emptied, "/dir1/file1.txt", &emptied_node);
+  asar_status emptied_status = asar_read_file_ex(emptied, "/dir1/file1.txt", emptied_content, sizeof(emptied_content) - 1, &emptied_size);
+  asar_close(emptied);
+  printf("emptied transform: unpacked /dir1/file1.txt (%d)\n", (int)emptied_size);
+  if (!emptied_node.unpacked || emptied_status != ok || emptied_size != 0 || emptied_content[0] != '\0') {
+    return 1;
+  }
+
+  if (test_concurrent_read(ASAR_OUTPUT_2) != 0) {
+    return 1;
+  }
+  if (test_async_read(ASAR_OUTPUT_2) != 0) {
+    return 1;
+  }
   return 0;
 }